@@ -0,0 +1,23 @@
+local_sources := $(shell find $(subdirectory) -maxdepth 1 -name '*.cpp')
+local_objects := $(addprefix $(OBJDIR)/,$(subst src/,,$(local_sources:.cpp=.o)) \
+   coarse_populations.o compositor.o creature.o creature_type.o creature_parser.o \
+   flow_field.o grid_search.o journal.o map_generator.o mapped_file.o \
+   path_hierarchy.o pool_allocator.o region_labels.o scenario.o species_cache.o \
+   step_stats.o thread_pool.o trace.o world.o z_order_index.o)
+local_program := $(OBJDIR)/$(subst src,,$(subdirectory))bench
+
+sources  += $(local_sources)
+programs += $(local_program)
+
+$(local_program) : local_ldflags = $(addprefix -L,$(ld_dirs)) $(all_ldflags)
+$(local_program) : local_ldlibs  = $(all_ldlibs) \
+   $$($(ICUCONFIG) --ldflags-libsonly) \
+   -lboost_regex \
+   $(patsubst lib%.a,-l%,$(notdir $(libraries)))
+
+.SECONDEXPANSION:
+
+$(local_program): $(local_objects) $$(libraries) | $$(dir $$@)
+	$(CXX) $(local_ldflags) $^ $(local_ldlibs) -o $@
+
+# vim: tw=90 ts=8 sts=-1 sw=3 noet
@@ -0,0 +1,719 @@
+// Headless workloads for performance work.  Runs the simulation without the GUI.
+
+#include <unistd.h>  // getopt
+
+#include <algorithm>           // std::min, std::minmax_element
+#include <atomic>              // atomic
+#include <chrono>              // steady_clock
+#include <cmath>               // std::hypot, std::sqrt
+#include <condition_variable>  // condition_variable
+#include <cstdlib>             // strtoul, strtoull
+#include <cstring>             // strcmp
+#include <exception>           // exception
+#include <fstream>             // ifstream
+#include <iomanip>             // setw, setprecision
+#include <iostream>
+#include <map>      // map
+#include <memory>   // unique_ptr
+#include <mutex>    // mutex, lock_guard, unique_lock
+#include <random>   // mt19937, uniform_int_distribution
+#include <sstream>  // istringstream, ostringstream
+#include <string>
+#include <thread>  // hardware_concurrency
+#include <utility>  // pair
+#include <vector>
+
+#include "flutterrust/compositor.hpp"
+#include "flutterrust/creature.hpp"
+#include "flutterrust/journal.hpp"
+#include "flutterrust/map_generator.hpp"
+#include "flutterrust/scenario.hpp"
+#include "flutterrust/step_stats.hpp"
+#include "flutterrust/thread_pool.hpp"
+#include "flutterrust/tuple_helpers.hpp"  // toUT
+#include "flutterrust/world.hpp"
+
+namespace c4o = std::chrono;
+
+namespace {
+struct Options {
+   std::string creatureTable = u8"CreatureTable.txt";
+   std::uint32_t seed = 0;
+   unsigned steps = 10;
+   std::size_t maxPopulation = 1000000;
+   FoodSearch foodSearch = FoodSearch::perAnimal;
+   NeighborLookup neighborLookup = NeighborLookup::zOrder;
+   CreatureStorage creatureStorage = CreatureStorage::hashMap;
+   std::size_t memoryCap = 0;  // Per world, in bytes; 0 for none.
+   // For the ensemble.
+   unsigned numWorlds = 64;
+   std::size_t population = 1000;  // Per world.
+   unsigned numThreads = std::thread::hardware_concurrency();
+   std::string journal;  // For replaying.
+};
+
+void printUsage(const char* program) {
+   std::cerr << "Usage: " << program
+             << " [-t TABLE] [-s SEED] [-n STEPS] [-m MAX] [-f] [-l] [-z]\n"
+             << "       [-c MIB] [-w WORLDS] [-p POPULATION] [-j THREADS] [-r JOURNAL]\n"
+             << "       MODE\n"
+             << "  -f     animals find food with per-step flow fields instead of\n"
+             << "         searching on their own\n"
+             << "  -l     count the creatures around a position with hash map lookups\n"
+             << "         instead of the per-step Z-order index\n"
+             << "  -z     commit each step by rebuilding the creatures in Z-order instead\n"
+             << "         of moving them one at a time\n"
+             << "  -c     cap the memory of each world at MIB mebibytes\n"
+             << "Modes:\n"
+             << "  scale  step scenarios of 1000, 10000, ... up to MAX creatures and\n"
+             << "         tabulate the time per step against the population size\n"
+             << "  memory step a scenario with MAX creatures for STEPS steps and show\n"
+             << "         where its memory goes\n"
+             << "  coarse step a scenario with MAX creatures for STEPS steps in view,\n"
+             << "         STEPS steps out of view, and bring it back into view\n"
+             << "  paint  compose STEPS frames of a 3840x2160 view of a scenario with\n"
+             << "         MAX creatures out of 32x32 sprites (no GUI involved)\n"
+             << "  paths  plan MAX paths between random positions of the same kind at\n"
+             << "         least 48 tiles apart with single-tile A* and with HPA*\n"
+             << "  sample draw MAX roaming and offspring targets from the same tile\n"
+             << "         and check that every reachable position is equally likely\n"
+             << "  terrain\n"
+             << "         generate 32x32 terrain blocks one by one, as one region, and\n"
+             << "         as one region on THREADS threads\n"
+             << "  ensemble\n"
+             << "         step WORLDS independent worlds of POPULATION creatures each\n"
+             << "         for STEPS steps on THREADS threads; world i uses the seed\n"
+             << "         SEED + i for its map and its simulation\n"
+             << "  replay replay the JOURNAL saved by the GUI up to step STEPS once\n"
+             << "         from step 0 and once from the closest checkpoint; compare\n";
+}
+
+// Populate a fresh world for each population size and measure the average duration of
+// `options.steps` steps.
+int runScalingReport(const Options& options) {
+   const std::size_t numTypes = Creature::getTypes().size();
+   std::cout << std::setw(10) << "target" << std::setw(10) << "initial" << std::setw(10)
+             << "final" << std::setw(12) << "ms/step" << std::setw(14) << "ns/creature"
+             << std::endl;
+   for (std::size_t population = 1000; population <= options.maxPopulation;
+        population *= 10) {
+      World world{options.seed};
+      world.setFoodSearch(options.foodSearch);
+      world.setNeighborLookup(options.neighborLookup);
+      world.setCreatureStorage(options.creatureStorage);
+      world.setMemoryCap(options.memoryCap);
+      Scenario scenario;
+      scenario.seed = options.seed;
+      scenario.plantsPerType = scenario.animalsPerType = population / numTypes;
+      populate(world, scenario);
+      const std::size_t initial = world.creatures.size();
+
+      auto startTime = c4o::steady_clock::now();
+      for (unsigned i = 0; i < options.steps; ++i) {
+         world.step();
+      }
+      auto endTime = c4o::steady_clock::now();
+      double ms = c4o::duration<double, std::milli>(endTime - startTime).count();
+      double msPerStep = ms / options.steps;
+      // Relative to the initial population; that's what the scenario controls.
+      double nsPerCreature = initial ? 1e6 * msPerStep / initial : 0.;
+
+      std::cout << std::setw(10) << population << std::setw(10) << initial
+                << std::setw(10) << world.creatures.size() << std::fixed
+                << std::setprecision(3) << std::setw(12) << msPerStep
+                << std::setprecision(1) << std::setw(14) << nsPerCreature << std::endl;
+   }
+   return 0;
+}
+
+// Step a scenario and break its memory use down after populating it and after every tenth
+// of the steps.
+int runMemoryReport(const Options& options) {
+   World world{options.seed};
+   world.setFoodSearch(options.foodSearch);
+   world.setNeighborLookup(options.neighborLookup);
+   world.setCreatureStorage(options.creatureStorage);
+   world.setMemoryCap(options.memoryCap);
+   Scenario scenario;
+   scenario.seed = options.seed;
+   scenario.plantsPerType = scenario.animalsPerType =
+       options.maxPopulation / Creature::getTypes().size();
+   populate(world, scenario);
+
+   const char* const columns[] = {"step",    "population", "creatures", "carcasses",
+                                  "terrain", "buffers",    "paths",     "searches",
+                                  "spare",   "total MiB"};
+   for (const char* column : columns) std::cout << std::setw(11) << column;
+   std::cout << std::endl;
+   const unsigned interval = std::max(1u, options.steps / 10);
+   for (unsigned step = 0; step <= options.steps; ++step) {
+      if (step > 0) world.step();
+      if (step % interval != 0 && step != options.steps) continue;
+      const MemoryUsage usage = world.getMemoryUsage();
+      constexpr double mebibyte = 1024. * 1024.;
+      std::cout << std::setw(11) << step << std::setw(11) << world.creatures.size()
+                << std::fixed << std::setprecision(2);
+      for (std::size_t bytes : {usage.creatures, usage.carcasses, usage.terrain,
+                                usage.stepBuffers, usage.pathCache, usage.searches,
+                                usage.spareNodes, usage.total()}) {
+         std::cout << std::setw(11) << bytes / mebibyte;
+      }
+      std::cout << std::endl;
+   }
+   return 0;
+}
+
+// Compare stepping a scenario in the cached terrain with stepping it as coarse
+// populations after moving the cache away, and show what's left when it comes back.
+int runCoarseReport(const Options& options) {
+   World world{options.seed};
+   world.setFoodSearch(options.foodSearch);
+   world.setNeighborLookup(options.neighborLookup);
+   world.setCreatureStorage(options.creatureStorage);
+   world.setMemoryCap(options.memoryCap);
+   Scenario scenario;
+   scenario.seed = options.seed;
+   scenario.plantsPerType = scenario.animalsPerType =
+       options.maxPopulation / Creature::getTypes().size();
+   populate(world, scenario);
+   const auto& coarse = world.getCoarsePopulations();
+
+   std::cout << std::setw(10) << "phase" << std::setw(12) << "creatures" << std::setw(12)
+             << "coarse" << std::setw(12) << "ms/step" << std::endl;
+   auto report = [&](const char* phase, double msPerStep) {
+      std::cout << std::setw(10) << phase << std::setw(12) << world.creatures.size()
+                << std::fixed << std::setprecision(1) << std::setw(12)
+                << coarse.getTotal() << std::setprecision(3) << std::setw(12)
+                << msPerStep << std::endl;
+   };
+   auto stepAll = [&] {
+      auto startTime = c4o::steady_clock::now();
+      for (unsigned i = 0; i < options.steps; ++i) world.step();
+      auto endTime = c4o::steady_clock::now();
+      return c4o::duration<double, std::milli>(endTime - startTime).count() /
+             options.steps;
+   };
+   report("start", 0.);
+   report("in view", stepAll());
+   // Far enough that none of the blocks stays cached.
+   constexpr std::int64_t away = 8 * MapGenerator::blockSize;
+   world.updateTerrainCache(scenario.left + away, scenario.top, scenario.width - 1,
+                            scenario.height - 1);
+   report("away", stepAll());
+   world.updateTerrainCache(scenario.left, scenario.top, scenario.width - 1,
+                            scenario.height - 1);
+   report("back", 0.);
+   return 0;
+}
+
+// An opaque tile in a flat color, standing in for terrain.
+Sprite makeTileSprite(std::uint8_t shade) {
+   const std::vector<std::uint8_t> rgb(32 * 32 * 3, shade);
+   return Sprite{32, 32, rgb.data(), nullptr};
+}
+
+// A disc with an antialiased edge on a transparent background, standing in for a
+// creature.  Has plenty of transparent, opaque, and partially transparent pixels.
+Sprite makeDiscSprite(std::uint8_t shade) {
+   std::vector<std::uint8_t> rgb(32 * 32 * 3, shade), alpha(32 * 32);
+   for (int y = 0; y < 32; ++y) {
+      for (int x = 0; x < 32; ++x) {
+         double coverage = 12. - std::hypot(x - 15.5, y - 15.5);
+         alpha[y * 32 + x] = static_cast<std::uint8_t>(
+             255 * std::min(1., coverage < 0. ? 0. : coverage));
+      }
+   }
+   return Sprite{32, 32, rgb.data(), alpha.data()};
+}
+
+// Compose frames the way `MainFrame::onPaint` does, minus the final blit.
+int runPaintBenchmark(const Options& options) {
+   constexpr int tileSize = 32, frameWidth = 3840, frameHeight = 2160;
+   const std::size_t numTypes = Creature::getTypes().size();
+   World world{options.seed};
+   Scenario scenario;
+   scenario.seed = options.seed;
+   scenario.plantsPerType = scenario.animalsPerType = options.maxPopulation / numTypes;
+   populate(world, scenario);
+
+   std::vector<Sprite> terrainSprites, creatureSprites;
+   for (int i = 0; i < 6; ++i) terrainSprites.push_back(makeTileSprite(40 * i));
+   for (std::size_t i = 0; i < numTypes; ++i) {
+      creatureSprites.push_back(makeDiscSprite(static_cast<std::uint8_t>(11 * i)));
+   }
+   const auto carcassSprite = makeDiscSprite(0);
+
+   Compositor compositor;
+   compositor.resize(frameWidth, frameHeight);
+   std::size_t spritesDrawn = 0;
+   auto startTime = c4o::steady_clock::now();
+   for (unsigned frame = 0; frame < options.steps; ++frame) {
+      for (std::int64_t worldY = 0; worldY * tileSize < frameHeight; ++worldY) {
+         for (std::int64_t worldX = 0; worldX * tileSize < frameWidth; ++worldX) {
+            const int x = worldX * tileSize, y = worldY * tileSize;
+            const auto tileType = world.getTileType(worldX, worldY);
+            compositor.draw(terrainSprites[toUT(tileType)], x, y);
+            ++spritesDrawn;
+            if (world.carcasses.find({worldX, worldY}) != world.carcasses.end()) {
+               compositor.draw(carcassSprite, x, y);
+               ++spritesDrawn;
+            }
+            auto range = world.creatures.equal_range({worldX, worldY});
+            for (auto it = range.first; it != range.second; ++it) {
+               compositor.draw(creatureSprites[it->second.getTypeIndex()], x, y);
+               ++spritesDrawn;
+            }
+         }
+      }
+   }
+   auto endTime = c4o::steady_clock::now();
+   double ms = c4o::duration<double, std::milli>(endTime - startTime).count();
+   std::cout << std::fixed << std::setprecision(3) << ms / options.steps
+             << " ms/frame, " << spritesDrawn / options.steps << " sprites/frame"
+             << std::endl;
+   return 0;
+}
+
+// The cost of moving along a path the way `World::moveTowards` would.
+int getPathCost(const World& world, const std::vector<World::Pos>& path) {
+   const bool onLand = world.isLand(path.back());
+   int cost = 0;
+   // The path is reversed; the start's cost doesn't count.
+   for (std::size_t i = 0; i + 1 < path.size(); ++i) {
+      cost += world.getMovementCost(path[i], onLand);
+   }
+   return cost;
+}
+
+// Compare single-tile A* with HPA* on long paths across the cached terrain.
+int runPathBenchmark(const Options& options) {
+   World world{options.seed};
+   Scenario scenario;
+   world.updateTerrainCache(scenario.left, scenario.top, scenario.width - 1,
+                            scenario.height - 1);
+   // Plan one path first, so the cluster graphs are built before timing.
+   std::vector<World::Pos> path;
+   world.getHierarchicalPath({0, 0}, {0, 0}, path);
+
+   std::mt19937 rNG{options.seed};
+   std::uniform_int_distribution<std::int64_t> xDist{0, scenario.width - 1};
+   std::uniform_int_distribution<std::int64_t> yDist{0, scenario.height - 1};
+   std::vector<std::pair<World::Pos, World::Pos>> queries;
+   while (queries.size() < options.maxPopulation) {
+      World::Pos start{xDist(rNG), yDist(rNG)}, dest{xDist(rNG), yDist(rNG)};
+      if (distance(start, dest) >= 48 && world.isLand(start) == world.isLand(dest)) {
+         queries.emplace_back(start, dest);
+      }
+   }
+
+   std::cout << std::setw(14) << "planner" << std::setw(12) << "us/path" << std::setw(14)
+             << "nodes/path" << std::setw(12) << "cost/path" << std::setw(10) << "reached"
+             << std::endl;
+   using Planner =
+       void (World::*)(World::Pos, World::Pos, std::vector<World::Pos>&) const;
+   const std::pair<const char*, Planner> planners[] = {
+       {"tiles", &World::getTilePath}, {"hierarchical", &World::getHierarchicalPath}};
+   for (const auto& planner : planners) {
+      std::uint64_t cost = 0, reached = 0;
+      world.stats.beginStep(0, Creature::getTypes().size());
+      auto startTime = c4o::steady_clock::now();
+      for (const auto& query : queries) {
+         (world.*planner.second)(query.first, query.second, path);
+         cost += getPathCost(world, path);
+         reached += path.front() == query.second;
+      }
+      auto endTime = c4o::steady_clock::now();
+      const StepRecord& record = world.stats[world.stats.size() - 1];
+      const auto nodes = record.total[toUT(Counter::pathNodes)];
+      double us = c4o::duration<double, std::micro>(endTime - startTime).count();
+      const double n = queries.size();
+      std::cout << std::setw(14) << planner.first << std::fixed << std::setprecision(1)
+                << std::setw(12) << us / n << std::setw(14) << nodes / n << std::setw(12)
+                << cost / n << std::setw(10) << reached << std::endl;
+   }
+   return 0;
+}
+
+// Check that `World::sampleReachablePosition` is uniform: histogram the positions it
+// returns from the center of the cached terrain and compare the histogram with the
+// uniform one by a chi-squared test.  Fails if any histogram deviates by more than five
+// standard deviations.
+int runSamplingCheck(const Options& options) {
+   World world{options.seed, options.seed};
+   Scenario scenario;
+   world.updateTerrainCache(scenario.left, scenario.top, scenario.width - 1,
+                            scenario.height - 1);
+   const World::Pos start{scenario.left + scenario.width / 2,
+                          scenario.top + scenario.height / 2};
+   // Like the targets of offspring and roaming animals.
+   const std::pair<int, bool> searches[] = {{1, false}, {3, false}, {10, true}};
+
+   std::cout << std::setw(8) << "maxDist" << std::setw(8) << "start" << std::setw(11)
+             << "positions" << std::setw(10) << "first %" << std::setw(11) << "uniform %"
+             << std::setw(12) << "chi2" << std::setw(8) << "dof" << std::endl;
+   bool isUniform = true;
+   for (const auto& search : searches) {
+      const int maxDist = search.first;
+      const bool includeStart = search.second;
+      // `start` comes first.
+      std::vector<World::Pos> positions = world.getReachablePositions(start, maxDist);
+      if (!includeStart) positions.erase(positions.begin());
+      if (positions.size() < 2) continue;
+      std::map<World::Pos, std::size_t> indices;
+      for (const auto& pos : positions) indices.emplace(pos, indices.size());
+      std::vector<std::uint64_t> counts(positions.size());
+      for (std::size_t n = 0; n < options.maxPopulation; ++n) {
+         const World::Pos sample =
+             world.sampleReachablePosition(start, maxDist, includeStart);
+         ++counts[indices.at(sample)];
+      }
+
+      const double expected = static_cast<double>(options.maxPopulation) / counts.size();
+      double chiSquared = 0;
+      for (auto count : counts) {
+         chiSquared += (count - expected) * (count - expected) / expected;
+      }
+      const double dof = counts.size() - 1.;
+      isUniform = isUniform && chiSquared < dof + 5 * std::sqrt(2 * dof);
+      std::cout << std::setw(8) << maxDist << std::setw(8)
+                << (includeStart ? "yes" : "no") << std::setw(11) << counts.size()
+                << std::fixed << std::setprecision(2) << std::setw(10)
+                << 100. * counts[0] / options.maxPopulation << std::setw(11)
+                << 100. / counts.size() << std::setw(12) << chiSquared << std::setw(8)
+                << std::setprecision(0) << dof << std::endl;
+   }
+   if (!isUniform) std::cerr << "error: the samples aren't uniform" << std::endl;
+   return isUniform ? 0 : 1;
+}
+
+// Compare generating terrain block by block with generating it as one region.
+int runTerrainBenchmark(const Options& options) {
+   constexpr std::size_t side = 32;
+   const MapGenerator mapGen{options.seed};
+   std::vector<MapGenerator::TerrainBlock> blocks(side * side);
+   ThreadPool pool{options.numThreads};
+   // Touch the blocks once, so the first method doesn't pay for faulting in the memory.
+   mapGen.getRegion(0, 0, side, side, blocks.data());
+
+   std::cout << std::setw(24) << "method" << std::setw(12) << "ms" << std::setw(12)
+             << "us/block" << std::endl;
+   auto report = [&](const char* method, c4o::steady_clock::time_point startTime) {
+      double ms = c4o::duration<double, std::milli>(c4o::steady_clock::now() - startTime)
+                      .count();
+      std::cout << std::setw(24) << method << std::fixed << std::setprecision(1)
+                << std::setw(12) << ms << std::setw(12) << 1e3 * ms / blocks.size()
+                << std::endl;
+   };
+   auto startTime = c4o::steady_clock::now();
+   for (std::size_t i = 0; i < side; ++i) {
+      for (std::size_t j = 0; j < side; ++j) blocks[i * side + j] = mapGen.getBlock(i, j);
+   }
+   report("getBlock", startTime);
+   startTime = c4o::steady_clock::now();
+   mapGen.getRegion(0, 0, side, side, blocks.data());
+   report("getRegion", startTime);
+   startTime = c4o::steady_clock::now();
+   mapGen.getRegion(0, 0, side, side, blocks.data(), &pool);
+   report("getRegion (pool)", startTime);
+   return 0;
+}
+
+// Replay a journal with and without its checkpoints; both have to reach the same state.
+int runReplay(const Options& options) {
+   std::ifstream iStream{options.journal};
+   if (!iStream.is_open()) {
+      std::cerr << "can't open journal " << options.journal << std::endl;
+      return 2;
+   }
+   const Journal journal{iStream};
+   std::cout << "map seed " << journal.getMapSeed() << ", seed " << journal.getSeed()
+             << ", recorded up to step " << journal.getLastStep()
+             << ", checkpoints every " << journal.getCheckpointInterval() << " steps"
+             << std::endl;
+
+   std::string states[2];
+   for (bool useCheckpoints : {false, true}) {
+      World world{journal.getMapSeed(), journal.getSeed()};
+      world.setMemoryCap(options.memoryCap);
+      const auto startTime = c4o::steady_clock::now();
+      journal.replay(world, options.steps, useCheckpoints);
+      double ms = c4o::duration<double, std::milli>(c4o::steady_clock::now() - startTime)
+                      .count();
+      std::cout << std::setw(16) << (useCheckpoints ? "from checkpoint" : "from step 0")
+                << std::fixed << std::setprecision(1) << std::setw(12) << ms << " ms"
+                << std::setw(10) << world.creatures.size() << " creatures" << std::endl;
+      std::ostringstream oStream;
+      world.writeState(oStream);
+      states[useCheckpoints] = oStream.str();
+   }
+   if (states[0] != states[1]) {
+      std::cout << "the states differ" << std::endl;
+      return 3;
+   }
+   std::cout << "the states are identical" << std::endl;
+   return 0;
+}
+
+// One world of an ensemble and what happened to it so far.
+struct EnsembleMember {
+   std::uint32_t seed = 0;
+   std::unique_ptr<World> world;
+   std::size_t initialPopulation = 0;
+   // The creature engine is thread-local, and the tasks of a world may run on any worker,
+   // so each world keeps the state of its own between tasks (see `stepMember`).
+   std::string creatureRNG;
+   std::atomic<unsigned> stepsDone{0};
+   // Summed over all steps.  Only touched by the task stepping the world.
+   std::array<std::uint64_t, toUT(Counter::SIZE)> totals{};
+   std::uint64_t creatureSteps = 0;  // Creatures alive after each step, summed up.
+   double milliseconds = 0;          // Spent in `World::step`.
+};
+
+// Lets the main thread wait for the last world to finish.
+class Countdown {
+  public:
+   explicit Countdown(std::size_t count) : count{count} {}
+   void countDown() {
+      std::lock_guard<std::mutex> lock{mutex};
+      if (--count == 0) done.notify_all();
+   }
+   // Returns whether the count reached zero.
+   template <typename Duration>
+   bool waitFor(Duration duration) {
+      std::unique_lock<std::mutex> lock{mutex};
+      return done.wait_for(lock, duration, [this] { return count == 0; });
+   }
+
+  private:
+   std::size_t count;
+   std::mutex mutex;
+   std::condition_variable done;
+};
+
+// Populate the member's world and step it once per task.  Each task posts the next step
+// of its world before returning, so a world tends to stay on the worker it started on
+// while idle workers steal other worlds' steps.  Worlds share the creature engine of the
+// worker stepping them, so every task swaps in the engine state of its world first and
+// saves it afterwards; that way, a world evolves the same regardless of which workers
+// step it and what they did before.
+void stepMember(ThreadPool& pool, EnsembleMember& member, const Options& options,
+                Countdown& countdown) {
+   World& world = *member.world;
+   if (member.creatureRNG.empty()) {
+      Creature::seedRNG(member.seed);
+   } else {
+      std::istringstream iStream{member.creatureRNG};
+      Creature::readRNG(iStream);
+   }
+   if (member.stepsDone == 0 && member.initialPopulation == 0 &&
+       world.creatures.empty()) {
+      Scenario scenario;
+      scenario.seed = member.seed;
+      scenario.plantsPerType = scenario.animalsPerType =
+          options.population / Creature::getTypes().size();
+      populate(world, scenario);
+      member.initialPopulation = world.creatures.size();
+   }
+   auto startTime = c4o::steady_clock::now();
+   world.step();
+   auto endTime = c4o::steady_clock::now();
+   member.milliseconds += c4o::duration<double, std::milli>(endTime - startTime).count();
+   const StepRecord& record = world.stats[world.stats.size() - 1];
+   for (std::size_t i = 0; i < member.totals.size(); ++i) {
+      member.totals[i] += record.total[i];
+   }
+   member.creatureSteps += world.creatures.size();
+   std::ostringstream oStream;
+   Creature::writeRNG(oStream);
+   member.creatureRNG = oStream.str();
+   if (++member.stepsDone < options.steps) {
+      pool.post([&] { stepMember(pool, member, options, countdown); });
+   } else {
+      countdown.countDown();
+   }
+}
+
+// One character per world: a digit for the tenths of its steps that are done, or '*'
+// once it's finished.
+void printProgress(const std::vector<std::unique_ptr<EnsembleMember>>& members,
+                   unsigned steps) {
+   std::string line;
+   line.reserve(members.size());
+   std::uint64_t stepsDone = 0;
+   for (const auto& member : members) {
+      const unsigned done = member->stepsDone;
+      stepsDone += done;
+      line += done == steps ? '*' : static_cast<char>('0' + 10 * done / steps);
+   }
+   std::cerr << std::setw(5) << 100 * stepsDone / (std::uint64_t{steps} * members.size())
+             << "% " << line << std::endl;
+}
+
+int runEnsemble(const Options& options) {
+   std::vector<std::unique_ptr<EnsembleMember>> members;
+   for (unsigned i = 0; i < options.numWorlds; ++i) {
+      members.push_back(std::make_unique<EnsembleMember>());
+      members.back()->seed = options.seed + i;
+      // Seeds the engine of both the map and the simulation, so the ensemble can be
+      // reproduced.
+      members.back()->world = std::make_unique<World>(options.seed + i, options.seed + i);
+      members.back()->world->setFoodSearch(options.foodSearch);
+      members.back()->world->setNeighborLookup(options.neighborLookup);
+      members.back()->world->setCreatureStorage(options.creatureStorage);
+      members.back()->world->setMemoryCap(options.memoryCap);
+   }
+
+   Countdown countdown{members.size()};
+   auto startTime = c4o::steady_clock::now();
+   {
+      ThreadPool pool{options.numThreads};
+      std::cerr << "Stepping " << members.size() << " worlds " << options.steps
+                << " times on " << pool.size() << " threads" << std::endl;
+      for (auto& member : members) {
+         pool.post([&] { stepMember(pool, *member, options, countdown); });
+      }
+      while (!countdown.waitFor(c4o::seconds{1})) {
+         printProgress(members, options.steps);
+      }
+   }
+   auto endTime = c4o::steady_clock::now();
+   double seconds = c4o::duration<double>(endTime - startTime).count();
+
+   std::cout << std::setw(6) << "world" << std::setw(12) << "seed" << std::setw(10)
+             << "initial" << std::setw(10) << "final" << std::setw(10) << "births"
+             << std::setw(10) << "deaths" << std::setw(12) << "ms/step" << '\n';
+   std::array<std::uint64_t, toUT(Counter::SIZE)> totals{};
+   std::uint64_t creatureSteps = 0;
+   for (std::size_t i = 0; i < members.size(); ++i) {
+      const EnsembleMember& member = *members[i];
+      std::cout << std::setw(6) << i << std::setw(12) << member.seed << std::setw(10)
+                << member.initialPopulation << std::setw(10)
+                << member.world->creatures.size() << std::setw(10)
+                << member.totals[toUT(Counter::births)] << std::setw(10)
+                << member.totals[toUT(Counter::deaths)] << std::fixed
+                << std::setprecision(3) << std::setw(12)
+                << member.milliseconds / options.steps << '\n';
+      for (std::size_t j = 0; j < totals.size(); ++j) totals[j] += member.totals[j];
+      creatureSteps += member.creatureSteps;
+   }
+
+   const auto populations = std::minmax_element(
+       members.begin(), members.end(), [](const auto& a, const auto& b) {
+          return a->world->creatures.size() < b->world->creatures.size();
+       });
+   std::size_t finalPopulation = 0;
+   for (const auto& member : members) finalPopulation += member->world->creatures.size();
+   const double worldSteps = static_cast<double>(options.steps) * members.size();
+   std::cout << "\nTotals over " << members.size() << " worlds and " << options.steps
+             << " steps each:\n";
+   for (std::size_t j = 0; j < totals.size(); ++j) {
+      std::cout << std::setw(16) << getName(static_cast<Counter>(j)) << std::setw(14)
+                << totals[j] << '\n';
+   }
+   std::cout << std::setprecision(1) << "final population: mean "
+             << double(finalPopulation) / members.size() << ", min "
+             << (*populations.first)->world->creatures.size() << ", max "
+             << (*populations.second)->world->creatures.size() << '\n'
+             << std::setprecision(3) << "wall time: " << seconds << " s, "
+             << worldSteps / seconds << " world steps/s, " << creatureSteps / seconds
+             << " creature steps/s" << std::endl;
+   return 0;
+}
+}
+
+int main(int argc, char* argv[]) {
+   Options options;
+   int opt;
+   while ((opt = getopt(argc, argv, "t:s:n:m:flzc:w:p:j:r:")) != -1) {
+      switch (opt) {
+         case 't':
+            options.creatureTable = optarg;
+            break;
+         case 's':
+            options.seed = std::strtoul(optarg, nullptr, 10);
+            break;
+         case 'n':
+            options.steps = std::strtoul(optarg, nullptr, 10);
+            break;
+         case 'm':
+            options.maxPopulation = std::strtoull(optarg, nullptr, 10);
+            break;
+         case 'f':
+            options.foodSearch = FoodSearch::flowFields;
+            break;
+         case 'l':
+            options.neighborLookup = NeighborLookup::hashMap;
+            break;
+         case 'z':
+            options.creatureStorage = CreatureStorage::zOrder;
+            break;
+         case 'c':
+            options.memoryCap = std::strtoull(optarg, nullptr, 10) << 20;
+            break;
+         case 'w':
+            options.numWorlds = std::strtoul(optarg, nullptr, 10);
+            break;
+         case 'p':
+            options.population = std::strtoull(optarg, nullptr, 10);
+            break;
+         case 'j':
+            options.numThreads = std::strtoul(optarg, nullptr, 10);
+            break;
+         case 'r':
+            options.journal = optarg;
+            break;
+         default:
+            printUsage(argv[0]);
+            return 1;
+      }
+   }
+   if (optind + 1 != argc || options.steps == 0 || options.numWorlds == 0) {
+      printUsage(argv[0]);
+      return 1;
+   }
+
+   try {
+      Creature::loadTypes(options.creatureTable);
+   } catch (const std::exception& e) {
+      std::cerr << argv[0] << ": " << e.what() << std::endl;
+      return 2;
+   }
+
+   const char* mode = argv[optind];
+   if (std::strcmp(mode, "scale") == 0) {
+      return runScalingReport(options);
+   }
+   if (std::strcmp(mode, "memory") == 0) {
+      return runMemoryReport(options);
+   }
+   if (std::strcmp(mode, "coarse") == 0) {
+      return runCoarseReport(options);
+   }
+   if (std::strcmp(mode, "paint") == 0) {
+      return runPaintBenchmark(options);
+   }
+   if (std::strcmp(mode, "paths") == 0) {
+      return runPathBenchmark(options);
+   }
+   if (std::strcmp(mode, "sample") == 0) {
+      return runSamplingCheck(options);
+   }
+   if (std::strcmp(mode, "terrain") == 0) {
+      return runTerrainBenchmark(options);
+   }
+   if (std::strcmp(mode, "ensemble") == 0) {
+      return runEnsemble(options);
+   }
+   if (std::strcmp(mode, "replay") == 0 && !options.journal.empty()) {
+      try {
+         return runReplay(options);
+      } catch (const std::exception& e) {
+         std::cerr << argv[0] << ": " << e.what() << std::endl;
+         return 2;
+      }
+   }
+   printUsage(argv[0]);
+   return 1;
+}
+
+// vim: tw=90 sts=-1 sw=3 et
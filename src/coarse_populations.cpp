@@ -0,0 +1,203 @@
+#include "coarse_populations.hpp"
+
+#include <algorithm>  // max, sort
+#include <istream>    // istream
+#include <limits>     // numeric_limits
+#include <ostream>    // ostream
+#include <stdexcept>  // runtime_error
+#include <utility>    // move
+
+#include "creature.hpp"
+#include "map_generator.hpp"
+#include "trace.hpp"
+
+constexpr int CoarsePopulations::interval;
+
+namespace {
+// `World::updatePlant` stops plants from procreating when there are 10 plants of their
+// type within 5 tiles, i.e. among 61 tiles.  Each type has that capacity on its own.
+constexpr float tilesPerPlant = 6.f;
+// The lifetime plants lose per step; 10 on good tiles and 25 on bad ones.
+constexpr float plantAging = 15.f;
+// The lifetime an animal loses per step when it doesn't move.
+constexpr float hunger = 5.f;
+// What an animal has to leech per step to keep its lifetime, since it only gains half of
+// it (see `World::leech`).
+constexpr float foodPerStep = 2 * hunger;
+// Populations below this count are extinct.
+constexpr float extinct = 0.01f;
+
+// The share of their needs `eaters` meet with `food` (both in individuals).
+float getShareFed(float food, float eaters) {
+   return food > 0 ? food / (food + eaters) : 0.f;
+}
+}
+
+void CoarsePopulations::addBlock(const Pos& block, int numWaterTiles, int numLandTiles) {
+   auto inserted = blocks.emplace(block, Block{});
+   if (!inserted.second) return;
+   Block& added = inserted.first->second;
+   added.numTiles = {{static_cast<std::uint16_t>(numWaterTiles),
+                      static_cast<std::uint16_t>(numLandTiles)}};
+   added.populations.assign(Creature::getTypes().size(), 0.f);
+}
+
+void CoarsePopulations::addCreature(const Pos& block, std::uint8_t typeIndex) {
+   blocks.at(block).populations[typeIndex] += 1.f;
+}
+
+std::vector<float> CoarsePopulations::takeBlock(const Pos& block) {
+   std::vector<float> populations;
+   auto it = blocks.find(block);
+   if (it != blocks.end()) {
+      populations = std::move(it->second.populations);
+      blocks.erase(it);
+   }
+   return populations;
+}
+
+void CoarsePopulations::step() {
+   TRACE_ZONE("CoarsePopulations::step");
+   for (int n = 0; n < interval; ++n) {
+      for (auto& entry : blocks) entry.second.previous = entry.second.populations;
+      for (auto& entry : blocks) stepBlock(entry.first, entry.second);
+   }
+}
+
+void CoarsePopulations::stepBlock(const Pos& pos, Block& block) const {
+   const std::vector<float>& before = block.previous;
+   // The populations of each kind, by medium (0 for water, 1 for land).
+   std::array<float, 2> plants{}, herbivores{}, carnivores{};
+   for (std::size_t type = 0; type < before.size(); ++type) {
+      const SpeciesTraits& traits =
+          Creature::getTypeTraits(static_cast<std::uint8_t>(type));
+      auto& kind = traits.isPlant() ? plants : traits.isCarnivore() ? carnivores
+                                                                    : herbivores;
+      kind[traits.isTerrestrial()] += before[type];
+   }
+   std::array<float, 2> herbivoresFed, carnivoresFed;
+   // The lifetime eaten per step.
+   std::array<float, 2> plantsEaten, herbivoresEaten;
+   for (int medium = 0; medium < 2; ++medium) {
+      herbivoresFed[medium] = getShareFed(plants[medium], herbivores[medium]);
+      carnivoresFed[medium] = getShareFed(herbivores[medium], carnivores[medium]);
+      plantsEaten[medium] = herbivores[medium] * herbivoresFed[medium] * foodPerStep;
+      herbivoresEaten[medium] = carnivores[medium] * carnivoresFed[medium] * foodPerStep;
+   }
+
+   const Block* neighbors[4];
+   const Pos neighborPositions[4]{
+       {{pos[0] - 1, pos[1]}}, {{pos[0] + 1, pos[1]}}, {{pos[0], pos[1] - 1}},
+       {{pos[0], pos[1] + 1}}};
+   for (int n = 0; n < 4; ++n) {
+      const auto it = blocks.find(neighborPositions[n]);
+      neighbors[n] = it == blocks.end() ? nullptr : &it->second;
+   }
+
+   for (std::size_t type = 0; type < before.size(); ++type) {
+      const float count = before[type];
+      const SpeciesTraits& traits =
+          Creature::getTypeTraits(static_cast<std::uint8_t>(type));
+      const int medium = traits.isTerrestrial();
+      const float maxLifetime = traits.maxLifetime;
+      // Eaten creatures have half their maximum lifetime left on average.
+      const float eatenLifetime = maxLifetime / 2;
+      float change;
+      if (traits.isPlant()) {
+         const float capacity = block.numTiles[medium] / tilesPerPlant;
+         const float growth =
+             capacity > 0 ? std::max(0.f, 1 - count / capacity) : 0.f;
+         change =
+             count * (growth / traits.procreationInterval - plantAging / maxLifetime);
+         if (plants[medium] > 0) {
+            change -= plantsEaten[medium] * (count / plants[medium]) / eatenLifetime;
+         }
+      } else {
+         const float fed =
+             traits.isCarnivore() ? carnivoresFed[medium] : herbivoresFed[medium];
+         change = count * (fed / traits.procreationInterval -
+                           (1 - fed) * hunger / maxLifetime);
+         if (traits.isHerbivore() && herbivores[medium] > 0) {
+            change -=
+                herbivoresEaten[medium] * (count / herbivores[medium]) / eatenLifetime;
+         }
+         // Exchange animals with each neighbor.  What leaves one block arrives in the
+         // other, so migration neither creates nor destroys animals.
+         if (block.numTiles[medium] > 0) {
+            const float migrationRate =
+                std::max<float>(1, traits.walkSpeed) / (4 * MapGenerator::blockSize);
+            for (const Block* neighbor : neighbors) {
+               if (neighbor && neighbor->numTiles[medium] > 0) {
+                  change += migrationRate * (neighbor->previous[type] - count);
+               }
+            }
+         }
+      }
+      const float after = count + change;
+      block.populations[type] = after < extinct ? 0.f : after;
+   }
+}
+
+double CoarsePopulations::getTotal() const {
+   double total = 0;
+   for (const auto& entry : blocks) {
+      for (float count : entry.second.populations) total += count;
+   }
+   return total;
+}
+
+std::size_t CoarsePopulations::bytesUsed() const {
+   // A node holds the entry and the pointer to the next one.
+   using Entry = std::pair<const Pos, Block>;
+   std::size_t bytes = blocks.bucket_count() * sizeof(void*) +
+                       blocks.size() * (sizeof(Entry) + sizeof(void*));
+   for (const auto& entry : blocks) {
+      bytes += (entry.second.populations.capacity() + entry.second.previous.capacity()) *
+               sizeof(float);
+   }
+   return bytes;
+}
+
+void CoarsePopulations::write(std::ostream& oStream) const {
+   using Entry = std::pair<const Pos, Block>;
+   std::vector<const Entry*> sorted;
+   sorted.reserve(blocks.size());
+   for (const auto& entry : blocks) sorted.push_back(&entry);
+   std::sort(sorted.begin(), sorted.end(),
+             [](const Entry* a, const Entry* b) { return a->first < b->first; });
+   const auto precision = oStream.precision(std::numeric_limits<float>::max_digits10);
+   oStream << blocks.size() << '\n';
+   for (const auto* entry : sorted) {
+      const Block& block = entry->second;
+      oStream << entry->first[0] << ' ' << entry->first[1] << ' ' << block.numTiles[0]
+              << ' ' << block.numTiles[1];
+      for (float count : block.populations) oStream << ' ' << count;
+      oStream << '\n';
+   }
+   oStream.precision(precision);
+}
+
+void CoarsePopulations::read(std::istream& iStream) {
+   const std::runtime_error invalid{"invalid coarse populations"};
+   std::size_t numBlocks;
+   iStream >> numBlocks;
+   if (!iStream) throw invalid;
+   decltype(blocks) newBlocks;
+   for (std::size_t n = 0; n < numBlocks; ++n) {
+      Pos pos;
+      Block block;
+      iStream >> pos[0] >> pos[1] >> block.numTiles[0] >> block.numTiles[1];
+      block.populations.resize(Creature::getTypes().size());
+      for (float& count : block.populations) iStream >> count;
+      if (!iStream || !newBlocks.emplace(pos, std::move(block)).second) throw invalid;
+   }
+   blocks.swap(newBlocks);
+}
+
+std::size_t CoarsePopulations::PosHash::operator()(const Pos& block) const {
+   // Blocks are few and close to each other; mix the coordinates a little.
+   return static_cast<std::size_t>(block[0]) * 0x9e3779b1u ^
+          static_cast<std::size_t>(block[1]);
+}
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,83 @@
+#ifndef COARSE_POPULATIONS_HPP_T7JW4NQB
+#define COARSE_POPULATIONS_HPP_T7JW4NQB
+
+#include <array>          // array
+#include <cstddef>        // size_t
+#include <cstdint>        // int64_t, uint8_t, uint16_t
+#include <iosfwd>         // istream, ostream
+#include <unordered_map>  // unordered_map
+#include <vector>         // vector
+
+// The creatures of terrain blocks that aren't cached, kept as the expected number of
+// creatures per block and species instead of individually.  Simulating individual
+// animals needs the terrain and searches over it, but these populations only change by
+// births, deaths, and migration between adjacent blocks, which are derived from the
+// traits of the species:
+//
+// - Plants of each type grow logistically up to a capacity given by the tiles of their
+//   medium in the block, and age at the rate `World::updatePlant` makes them lose
+//   lifetime.
+// - Animals eat the plants (herbivores) or herbivores (carnivores) of their medium in the
+//   block.  The share of their needs they meet decides whether they procreate once per
+//   procreation interval or starve.
+// - Animals wander off to each adjacent block with habitat for them at a rate that grows
+//   with their walking speed.  The cached terrain isn't adjacent to anything.
+//
+// The populations are advanced `interval` steps at a time, one step after another, and
+// every block is computed from the populations of the previous step, so the result
+// doesn't depend on the order of the blocks.
+class CoarsePopulations {
+  public:
+   using Pos = std::array<std::int64_t, 2>;  // (x, y) of a block.
+
+   // The number of steps `step` simulates.
+   static constexpr int interval = 16;
+
+   // Add an empty block with `numWaterTiles` and `numLandTiles` unless it's there
+   // already.  Populations only live in blocks with tiles of their medium.
+   void addBlock(const Pos& block, int numWaterTiles, int numLandTiles);
+   // Add a creature of the type with the index `typeIndex` to the added `block`.
+   void addCreature(const Pos& block, std::uint8_t typeIndex);
+   // Remove `block` and return its expected populations by type index; empty if it
+   // wasn't added.
+   std::vector<float> takeBlock(const Pos& block);
+
+   // Simulate `interval` steps.
+   void step();
+
+   std::size_t getNumBlocks() const { return blocks.size(); }
+   // The expected number of creatures in all blocks.
+   double getTotal() const;
+
+   void clear() { blocks.clear(); }
+
+   // The memory held by the blocks.
+   std::size_t bytesUsed() const;
+
+   // One line per block, sorted by position, with its tiles and populations.  Writes the
+   // populations exactly, so reading them back gives the same results.
+   void write(std::ostream&) const;
+   // Replace the blocks with those written by `write`.  Throws `std::runtime_error` if
+   // they can't be parsed.
+   void read(std::istream&);
+
+  private:
+   struct Block {
+      std::array<std::uint16_t, 2> numTiles;  // By medium: water, land.
+      std::vector<float> populations;         // By type index.
+      std::vector<float> previous;            // Scratch space of `step`.
+   };
+
+   struct PosHash {
+      std::size_t operator()(const Pos& block) const;
+   };
+
+   // Compute `block.populations` of the next step from the `previous` populations.
+   void stepBlock(const Pos& pos, Block& block) const;
+
+   std::unordered_map<Pos, Block, PosHash> blocks;
+};
+
+#endif  // COARSE_POPULATIONS_HPP_T7JW4NQB
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,114 @@
+#include "compositor.hpp"
+
+#include <algorithm>  // std::max, std::min
+#include <cstring>    // std::memcpy
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+// dst = src + dst * (255 - alpha(src)) / 255 for each channel, rounded to nearest.
+inline std::uint32_t blend(std::uint32_t src, std::uint32_t dst) {
+   const std::uint32_t inverseAlpha = 255 - (src >> 24);
+   std::uint32_t result = 0;
+   for (int shift = 0; shift < 32; shift += 8) {
+      std::uint32_t t = ((dst >> shift) & 0xff) * inverseAlpha + 128;
+      t = (t + (t >> 8)) >> 8;
+      result |= (((src >> shift) & 0xff) + t) << shift;
+   }
+   return result;
+}
+
+#ifdef __SSE2__
+// The same as `blend` for two pixels widened to 16-bit lanes.
+inline __m128i blend16(__m128i src, __m128i dst) {
+   // Broadcast the alpha of each pixel to its four lanes.
+   __m128i alpha = _mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3));
+   alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+   const __m128i inverseAlpha = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+   __m128i t = _mm_add_epi16(_mm_mullo_epi16(dst, inverseAlpha), _mm_set1_epi16(128));
+   t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+   return _mm_add_epi16(src, t);
+}
+#endif
+
+void blendRow(const std::uint32_t* src, std::uint32_t* dst, int n) {
+   int i = 0;
+#ifdef __SSE2__
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000u));
+   for (; i + 4 <= n; i += 4) {
+      const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      const __m128i alpha = _mm_and_si128(s, alphaMask);
+      // Sprites are mostly made up of fully transparent and fully opaque pixels.
+      if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xffff) continue;
+      if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask)) == 0xffff) {
+         _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), s);
+         continue;
+      }
+      const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+      const __m128i low =
+          blend16(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+      const __m128i high =
+          blend16(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(low, high));
+   }
+#endif
+   for (; i < n; ++i) {
+      dst[i] = blend(src[i], dst[i]);
+   }
+}
+}
+
+Sprite::Sprite(int width, int height, const std::uint8_t* rgb, const std::uint8_t* alpha)
+    : width{width}, height{height}, pixels(std::size_t(width) * height) {
+   for (std::size_t i = 0; i < pixels.size(); ++i, rgb += 3) {
+      const std::uint32_t a = alpha ? alpha[i] : 255;
+      if (a != 255) isOpaque = false;
+      // Premultiply, rounding to nearest.
+      auto scale = [a](std::uint32_t c) { return (c * a + 127) / 255; };
+      pixels[i] = a << 24 | scale(rgb[0]) << 16 | scale(rgb[1]) << 8 | scale(rgb[2]);
+   }
+}
+
+Sprite::Sprite(const TargaImage& image)
+    : width{static_cast<int>(image.width)},
+      height{static_cast<int>(image.height)},
+      pixels(image.pixels.size()) {
+   for (int row = 0; row < height; ++row) {
+      const auto* src = &image.pixels[std::size_t(height - 1 - row) * width];
+      auto* dst = &pixels[std::size_t(row) * width];
+      for (int col = 0; col < width; ++col) {
+         const auto& bgra = src[col];
+         const std::uint32_t a = bgra[3];
+         if (a != 255) isOpaque = false;
+         auto scale = [a](std::uint32_t c) { return (c * a + 127) / 255; };
+         dst[col] = a << 24 | scale(bgra[2]) << 16 | scale(bgra[1]) << 8 | scale(bgra[0]);
+      }
+   }
+}
+
+void Compositor::resize(int width, int height) {
+   this->width = width;
+   this->height = height;
+   pixels.resize(std::size_t(width) * height);
+}
+
+void Compositor::draw(const Sprite& sprite, int x, int y) {
+   const int left = std::max(x, 0), right = std::min(x + sprite.width, width);
+   const int top = std::max(y, 0), bottom = std::min(y + sprite.height, height);
+   if (left >= right || top >= bottom) return;
+   const int n = right - left;
+   for (int row = top; row < bottom; ++row) {
+      const auto* src = &sprite.pixels[std::size_t(row - y) * sprite.width + (left - x)];
+      auto* dst = &pixels[std::size_t(row) * width + left];
+      if (sprite.isOpaque) {
+         std::memcpy(dst, src, n * sizeof(*dst));
+      } else {
+         blendRow(src, dst, n);
+      }
+   }
+}
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,53 @@
+#ifndef COMPOSITOR_HPP_Q7MZC3LW
+#define COMPOSITOR_HPP_Q7MZC3LW
+
+#include <cstdint>  // uint8_t, uint32_t
+#include <vector>   // vector
+
+#include "targa.hpp"
+
+// An image with premultiplied alpha.  Pixels are stored row by row from the top as
+// 0xAARRGGBB values, i.e. in blue, green, red, alpha byte order on little-endian
+// machines.
+struct Sprite {
+   Sprite() = default;
+   // Convert an image with straight alpha stored the way `wxImage` stores it: three bytes
+   // (red, green, blue) per pixel and, optionally, a separate alpha plane.  Without one,
+   // the sprite is opaque.
+   Sprite(int width, int height, const std::uint8_t* rgb, const std::uint8_t* alpha);
+   // Convert a decoded TGA file (straight alpha, bottom row first).
+   explicit Sprite(const TargaImage&);
+
+   int width = 0;
+   int height = 0;
+   bool isOpaque = true;  // Every pixel has an alpha of 255; drawing can simply copy.
+   std::vector<std::uint32_t> pixels;
+};
+
+// Composes a frame out of sprites in a single RGBA buffer in memory, so the GUI toolkit
+// only needs to blit one bitmap per frame.  Blending uses SSE2 where available.
+class Compositor {
+  public:
+   // Resize the frame buffer.  Its contents are unspecified afterwards.
+   void resize(int width, int height);
+
+   int getWidth() const { return width; }
+   int getHeight() const { return height; }
+
+   // Blend `sprite` over the frame with its top left corner at (x, y).  Parts outside of
+   // the frame are clipped.
+   void draw(const Sprite&, int x, int y);
+
+   // Row `y` of the frame, counted from the top.  The alpha bytes of the frame are
+   // meaningless; it is opaque as long as opaque sprites cover it.
+   const std::uint32_t* row(int y) const { return &pixels[std::size_t(y) * width]; }
+
+  private:
+   int width = 0;
+   int height = 0;
+   std::vector<std::uint32_t> pixels;
+};
+
+#endif  // COMPOSITOR_HPP_Q7MZC3LW
+
+// vim: tw=90 sts=-1 sw=3 et
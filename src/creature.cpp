@@ -1,29 +1,27 @@
 #include "creature.hpp"
 
-#include <fstream>    // ifstream
+#include <istream>    // std::istream, std::ws
+#include <ostream>    // std::ostream
 #include <random>     // std::default_random_engine, std::random_device, ...
-#include <stdexcept>  // runtime_error
 #include <vector>     // vector
 
-#include "creature_parser.hpp"
+#include "species_cache.hpp"
 
 void Creature::loadTypes(std::string filePath) {
-   std::ifstream iStream{filePath};
-
-   if (!iStream.is_open()) {
-      throw std::runtime_error{u8"couldn't open file " + filePath};
-   }
-
-   iStream.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
    std::vector<std::string> errors;
-   creatureTypes = loadCreatureTypes(std::move(iStream), errors);
+   creatureTypes = loadCreatureTypesCached(filePath, errors);
+   speciesTraits.clear();
+   speciesTraits.reserve(creatureTypes.size());
+   for (const auto& creatureType : creatureTypes) {
+      speciesTraits.push_back(deriveTraits(creatureType));
+   }
 }
 
 namespace {
-std::default_random_engine rNG(std::random_device{}());
+// Creatures may be created by worlds stepped on different threads.
+thread_local std::default_random_engine rNG(std::random_device{}());
 // Distribution ranging from 0 to the highest representable value.
-std::uniform_int_distribution<int> defaultRNDist{};
+thread_local std::uniform_int_distribution<int> defaultRNDist{};
 }
 
 Creature::Creature(std::uint8_t typeIndex)
@@ -38,6 +36,13 @@ Creature::Creature(std::uint8_t typeIndex, std::int16_t lifetime)
           isPlant() ? defaultRNDist(rNG) % getProcreationInterval()
                     : getProcreationInterval() - 1)} {}
 
+void Creature::seedRNG(std::uint_fast32_t seed) { rNG.seed(seed); }
+
+void Creature::writeRNG(std::ostream& oStream) { oStream << rNG; }
+
+void Creature::readRNG(std::istream& iStream) { iStream >> std::ws >> rNG; }
+
 std::vector<CreatureType> Creature::creatureTypes;
+std::vector<SpeciesTraits> Creature::speciesTraits;
 
 // vim: tw=90 sts=-1 sw=3 et
@@ -2,7 +2,8 @@
 #define CREATURE_HPP_XZNFGDOY
 
 #include <cassert>  // assert
-#include <cstdint>  // std::uint8_t, std::int16_t, std::uint16_t
+#include <cstdint>  // std::uint8_t, std::int16_t, std::uint16_t, std::uint_fast32_t
+#include <iosfwd>   // std::istream, std::ostream
 #include <string>   // std::string
 #include <vector>   // std::vector
 
@@ -17,12 +18,22 @@ extern const std::uint16_t defaultAiState;
 struct Creature {
    static void loadTypes(std::string filePath);
    inline static const std::vector<CreatureType>& getTypes();
+   // The traits of the type with the index `typeIndex`.
+   inline static const SpeciesTraits& getTypeTraits(std::uint8_t typeIndex);
+
+   // New plants draw their procreation offset from an engine shared by all creatures
+   // created on the calling thread.  `World` seeds it and saves its state along with its
+   // own, so replaying a world reproduces the offsets.
+   static void seedRNG(std::uint_fast32_t seed);
+   static void writeRNG(std::ostream&);
+   static void readRNG(std::istream&);
 
    Creature(std::uint8_t typeIndex);
    Creature(std::uint8_t typeIndex, std::int16_t lifetime);
 
    inline std::uint8_t getTypeIndex() const;
    inline const CreatureType& getType() const;
+   inline const SpeciesTraits& getTraits() const;
 
    inline const std::string& getName() const;
    inline int getStrength() const;
@@ -59,37 +70,40 @@ struct Creature {
 
   private:
    static std::vector<CreatureType> creatureTypes;
+   // Derived from `creatureTypes`; uses the same indices.
+   static std::vector<SpeciesTraits> speciesTraits;
 };
 
 const std::vector<CreatureType>& Creature::getTypes() { return creatureTypes; }
+const SpeciesTraits& Creature::getTypeTraits(std::uint8_t typeIndex) {
+   return speciesTraits[typeIndex];
+}
 
 std::uint8_t Creature::getTypeIndex() const { return typeIndex; }
 const CreatureType& Creature::getType() const { return creatureTypes[getTypeIndex()]; }
+const SpeciesTraits& Creature::getTraits() const { return speciesTraits[getTypeIndex()]; }
 
 const std::string& Creature::getName() const { return getType().getName(); }
-int Creature::getStrength() const { return getType().getStrength(); }
+int Creature::getStrength() const { return getTraits().strength; }
 int Creature::getSpeed() const { return getType().getSpeed(); }
-std::int16_t Creature::getMaxLifetime() const { return getType().getMaxLifetime(); }
+std::int16_t Creature::getMaxLifetime() const { return getTraits().maxLifetime; }
 std::string Creature::getAttributeString() const {
    return getType().getAttributeString();
 }
 const std::string& Creature::getBitmapName() const { return getType().getBitmapName(); }
 
-bool Creature::isAquatic() const { return getType().isAquatic(); }
-bool Creature::isTerrestrial() const { return getType().isTerrestrial(); }
-bool Creature::isPlant() const { return getType().isPlant(); }
-bool Creature::isAnimal() const { return getType().isAnimal(); }
-bool Creature::isHerbivore() const { return getType().isHerbivore(); }
+bool Creature::isAquatic() const { return getTraits().isAquatic(); }
+bool Creature::isTerrestrial() const { return getTraits().isTerrestrial(); }
+bool Creature::isPlant() const { return getTraits().isPlant(); }
+bool Creature::isAnimal() const { return getTraits().isAnimal(); }
+bool Creature::isHerbivore() const { return getTraits().isHerbivore(); }
 bool Creature::isCarnivore() const {
    // Assert it's an animal; plants aren't partitioned into herbivores and carnivores.
    assert(isAnimal());
-   return getType().isCarnivore();
+   return getTraits().isCarnivore();
 }
 
-int Creature::getProcreationInterval() const {
-   auto maxLifetime = getMaxLifetime();
-   return isPlant() ? maxLifetime / 100 : maxLifetime / 50;
-}
+int Creature::getProcreationInterval() const { return getTraits().procreationInterval; }
 
 float Creature::getRelativeLifetime() const {
    return static_cast<float>(lifetime) / getMaxLifetime();
@@ -97,20 +111,22 @@ float Creature::getRelativeLifetime() const {
 
 bool Creature::isHungry() const {
    assert(isAnimal());
-   return getRelativeLifetime() < 0.6;
+   return lifetime < getTraits().hungryBelow;  // getRelativeLifetime() < 0.6
 }
 
 bool Creature::isSated() const { return lifetime == getMaxLifetime(); }
 
-int Creature::getWalkSpeed() const { return getSpeed() / 20; }
+int Creature::getWalkSpeed() const { return getTraits().walkSpeed; }
 
-int Creature::getRunSpeed() const { return getSpeed() / 10; }
+int Creature::getRunSpeed() const { return getTraits().runSpeed; }
 
 bool Creature::canProcreate(int step) const {
-   if (isPlant()) {
-      return step % getProcreationInterval() == procreationOffset;
+   const SpeciesTraits& traits = getTraits();
+   if (traits.isPlant()) {
+      return step % traits.procreationInterval == procreationOffset;
    } else {
-      return procreationOffset == 0 && getRelativeLifetime() > 0.5;
+      // getRelativeLifetime() > 0.5
+      return procreationOffset == 0 && lifetime >= traits.procreateFrom;
    }
 }
 
@@ -1,97 +1,132 @@
 #include "creature_parser.hpp"
 
-#include <algorithm>  // std::transform
-#include <cctype>     // std::tolower (TODO: use the one from <locale>?)
-#include <set>        // std::set
-#include <sstream>    // std::stringstream
+#include <algorithm>  // std::equal, std::find_if, std::find_if_not
+#include <cctype>     // std::tolower (TODO: use the one from <locale>?), std::isspace
 #include <string>     // std::string
 #include <tuple>      // std::make_tuple
 #include <utility>    // std::move
 #include <vector>     // std::vector
 
+#include "mapped_file.hpp"
+
 #ifdef DEBUG
 #include <iostream>
 #endif
 
-auto getAttrs = [](std::string s) -> CreatureAttrs {
+namespace {
+// The words allowed in the attributes field, all lowercase.
+const boost::string_view attributeWords[] = {"landbewohner",   "wasserbewohner",
+                                             "tier",           "pflanze",
+                                             "fleischfresser", "pflanzenfresser"};
+enum : unsigned {
+   landbewohner = 1 << 0,
+   wasserbewohner = 1 << 1,
+   tier = 1 << 2,
+   pflanze = 1 << 3,
+   fleischfresser = 1 << 4,
+   pflanzenfresser = 1 << 5
+};
+
+bool equalsIgnoringCase(boost::string_view word, boost::string_view lowercase) {
+   return word.size() == lowercase.size() &&
+          std::equal(word.begin(), word.end(), lowercase.begin(), [](char a, char b) {
+             return std::tolower(static_cast<unsigned char>(a)) == b;
+          });
+}
+}
+
+const auto getAttrs = [](boost::string_view s) -> CreatureAttrs {
    // Assert we get exactly one string out of each of these sets: {Landbewohner,
    // Wasserbewohner}, {Pflanze, Tier} and, only in case we got "Tier", {Pflanzenfresser,
    // Fleischfresser}.  Disregard capitalization.
-   std::transform(s.begin(), s.end(), s.begin(), [](char c) { return std::tolower(c); });
-   std::stringstream stream{s};
-   std::set<std::string> words;
-   {
-      std::string attribute;
-      while (stream >> attribute) {
-         words.insert(attribute);
+   unsigned words = 0;
+   bool unknownWords = false;
+   for (auto it = s.begin(); it != s.end();) {
+      auto isSpace = [](char c) { return std::isspace(static_cast<unsigned char>(c)); };
+      it = std::find_if_not(it, s.end(), isSpace);
+      auto wordEnd = std::find_if(it, s.end(), isSpace);
+      if (it == wordEnd) break;
+      const boost::string_view word(it, wordEnd - it);
+      bool known = false;
+      for (unsigned i = 0; i < 6; ++i) {
+         if (equalsIgnoringCase(word, attributeWords[i])) {
+            words |= 1u << i;
+            known = true;
+            break;
+         }
       }
+      unknownWords |= !known;
+      it = wordEnd;
    }
    std::bitset<3> bitset;
-   if (words.find("landbewohner") != words.end()) {
+   if (words & landbewohner) {
       bitset.flip(0);
-      if (words.find("wasserbewohner") != words.end()) {
+      if (words & wasserbewohner) {
          throw std::string{
              "\"Wasserbewohner\" and \"Landbewohner\" are mutually exclusive"};
       }
-   } else if (words.find("wasserbewohner") == words.end()) {
+   } else if (!(words & wasserbewohner)) {
       throw std::string{"expected \"Wasserbewohner\" or \"Landbewohner\" in attributes"};
    }
-   if (words.find("tier") != words.end()) {
+   if (words & tier) {
       bitset.flip(1);
-      if (words.find("pflanze") != words.end()) {
+      if (words & pflanze) {
          throw std::string{"\"Pflanze\" and \"Tier\" are mutually exclusive"};
       }
-   } else if (words.find("pflanze") == words.end()) {
+   } else if (!(words & pflanze)) {
       throw std::string{"expected \"Pflanze\" or \"Tier\" in attributes"};
    }
    if (!bitset.test(1)) {
       // Plants should have exactly two attributes.
-      if (words.size() > 2) {
+      if (unknownWords || (words & (fleischfresser | pflanzenfresser))) {
          throw std::string{"unexpected attributes encountered"};
       }
    } else {
-      if (words.find("fleischfresser") != words.end()) {
+      if (words & fleischfresser) {
          bitset.flip(2);
-         if (words.find("pflanzenfresser") != words.end()) {
+         if (words & pflanzenfresser) {
             throw std::string{
                 "\"Pflanzenfresser\" and \"Fleischfresser\" are mutually exclusive"};
          }
-      } else if (words.find("pflanzenfresser") == words.end()) {
+      } else if (!(words & pflanzenfresser)) {
          throw std::string{
              "expected \"Pflanzenfresser\" or \"Fleischfresser\" in attributes"};
       }
-      if (words.size() > 3) {
+      if (unknownWords) {
          throw std::string{"unexpected attributes encountered"};
       }
    }
-   /*
-   if (s.find("landbewohner") != std::string::npos) {
-      // It's terrestrial.
-      bitset.flip(0);
-   }
-   if (s.find("wasserbewohner") != std::string::npos) {
-      // It's aquatic.
-      if (bitset.test(0)) {
-         // But it's already a land thing.
-         throw std::string{
-             "\"Landbewohner\" and \"Wasserbewohner\" are mutually exclusive"};
-      }
-   } else if (!bitset.test(0)) {
-      // It's neither a land nor a water thing.
-      throw std::string{"expected \"Landbewohner\" or \"Wasserbewohner\" in attributes"};
-   }
-   */
    return CreatureAttrs{bitset};
 };
 
 namespace {
 auto extractors = std::make_tuple(getName, getInt, getInt, getInt, getAttrs, getPath);
+
+// Wrap each parsed tuple in a `CreatureType`.
+std::vector<CreatureType> toCreatureTypes(std::vector<CreatureType::Tuple>&& tuples) {
+   std::vector<CreatureType> creatureTypes;
+   creatureTypes.reserve(tuples.size());
+   for (auto& tuple : tuples) creatureTypes.push_back(CreatureType{std::move(tuple)});
+   return creatureTypes;
+}
 }
 
 std::vector<CreatureType> loadCreatureTypes(std::istream&& iS,
                                             std::vector<std::string>& errors) {
-   auto tuples = loadResources<CreatureType::Tuple>(std::move(iS), extractors, errors);
-   return *reinterpret_cast<std::vector<CreatureType>*>(&tuples);  // Don't judge me!
+   return toCreatureTypes(
+       loadResources<CreatureType::Tuple>(std::move(iS), extractors, errors));
+}
+
+std::vector<CreatureType> loadCreatureTypes(const char* first, const char* last,
+                                            std::vector<std::string>& errors) {
+   return toCreatureTypes(
+       loadResources<CreatureType::Tuple>(first, last, extractors, errors));
+}
+
+std::vector<CreatureType> loadCreatureTypes(const std::string& filePath,
+                                            std::vector<std::string>& errors) {
+   const MappedFile file{filePath};
+   return loadCreatureTypes(file.begin(), file.end(), errors);
 }
 
 // vim: tw=90 sts=-1 sw=3 et
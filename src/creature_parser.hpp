@@ -11,6 +11,15 @@
 std::vector<CreatureType> loadCreatureTypes(std::istream&&,
                                             std::vector<std::string>& errors);
 
+// Parse a table that is already in memory.
+std::vector<CreatureType> loadCreatureTypes(const char* first, const char* last,
+                                            std::vector<std::string>& errors);
+
+// Map the file into memory and parse it in place.  Throws `std::runtime_error` if the
+// file can't be opened.
+std::vector<CreatureType> loadCreatureTypes(const std::string& filePath,
+                                            std::vector<std::string>& errors);
+
 // For those who don't care.
 std::vector<CreatureType> loadCreatureTypes(std::istream&&);
 
@@ -25,4 +25,36 @@ std::ostream& operator<<(std::ostream& oS, const CreatureAttrs& creatureAttrs) {
    return oS;
 }
 
+SpeciesTraits deriveTraits(const CreatureType& type) {
+   SpeciesTraits traits;
+   traits.flags = static_cast<std::uint8_t>(
+       (type.isTerrestrial() ? SpeciesTraits::terrestrial : 0) |
+       (type.isAnimal() ? SpeciesTraits::animal : 0) |
+       (type.isCarnivore() ? SpeciesTraits::carnivore : 0));
+   traits.strength = type.getStrength();
+   traits.maxLifetime = type.getMaxLifetime();
+   traits.procreationInterval =
+       type.isPlant() ? traits.maxLifetime / 100 : traits.maxLifetime / 50;
+   traits.walkSpeed = type.getSpeed() / 20;
+   traits.runSpeed = type.getSpeed() / 10;
+
+   // Find the thresholds by evaluating exactly the floating-point comparisons they
+   // replace; `Creature::getRelativeLifetime` divides by the maximum lifetime.
+   const auto maxLifetime = traits.maxLifetime;
+   auto relativeLifetime = [maxLifetime](std::int32_t lifetime) {
+      return static_cast<float>(lifetime) / maxLifetime;
+   };
+   traits.hungryBelow = 0;
+   while (traits.hungryBelow <= maxLifetime &&
+          relativeLifetime(traits.hungryBelow) < 0.6) {
+      ++traits.hungryBelow;
+   }
+   traits.procreateFrom = 0;
+   while (traits.procreateFrom <= maxLifetime &&
+          !(relativeLifetime(traits.procreateFrom) > 0.5)) {
+      ++traits.procreateFrom;
+   }
+   return traits;
+}
+
 // vim: tw=90 sts=-1 sw=3 et
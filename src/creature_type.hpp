@@ -2,7 +2,7 @@
 #define CREATURE_TYPE_HPP_21UKGANC
 
 #include <bitset>
-#include <cstdint>  // int16_t
+#include <cstdint>  // int16_t, int32_t, uint8_t
 #include <ostream>
 #include <string>
 #include <tuple>
@@ -43,6 +43,33 @@ struct CreatureType {
    inline CreatureAttrs getAttributes() const;
 };
 
+// The properties of a creature type the simulation needs for every creature in every
+// step, derived from a `CreatureType` once and packed into a few bytes.  Ratios of the
+// lifetime are precomputed as thresholds of the lifetime itself.
+struct SpeciesTraits {
+   enum : std::uint8_t { terrestrial = 1 << 0, animal = 1 << 1, carnivore = 1 << 2 };
+
+   inline bool isAquatic() const;
+   inline bool isTerrestrial() const;
+   inline bool isPlant() const;
+   inline bool isAnimal() const;
+   inline bool isHerbivore() const;
+   inline bool isCarnivore() const;
+
+   std::int32_t strength;
+   // A creature with a lifetime below this value is hungry.
+   std::int32_t hungryBelow;
+   // An animal needs a lifetime of at least this value to procreate.
+   std::int32_t procreateFrom;
+   std::int16_t maxLifetime;
+   std::int16_t procreationInterval;
+   std::int16_t walkSpeed;
+   std::int16_t runSpeed;
+   std::uint8_t flags;
+};
+
+SpeciesTraits deriveTraits(const CreatureType&);
+
 // Names for the tuple elements to replace obscure code like `std::get<4>(creatureType)`
 // with `std::get<cTFields::attributes>(creatureType).
 namespace {
@@ -87,6 +114,15 @@ bool CreatureType::isAnimal() const { return getAttributes().isAnimal(); }
 bool CreatureType::isHerbivore() const { return getAttributes().isHerbivore(); }
 bool CreatureType::isCarnivore() const { return getAttributes().isCarnivore(); }
 
+bool SpeciesTraits::isAquatic() const { return !(flags & terrestrial); }
+bool SpeciesTraits::isTerrestrial() const { return flags & terrestrial; }
+bool SpeciesTraits::isPlant() const { return !(flags & animal); }
+bool SpeciesTraits::isAnimal() const { return flags & animal; }
+bool SpeciesTraits::isHerbivore() const {
+   return (flags & (animal | carnivore)) == animal;
+}
+bool SpeciesTraits::isCarnivore() const { return flags & carnivore; }
+
 #endif  // CREATURE_TYPE_HPP_21UKGANC
 
 // vim: tw=90 sts=-1 sw=3 et
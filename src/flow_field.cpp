@@ -0,0 +1,16 @@
+#include "flow_field.hpp"
+
+constexpr std::uint8_t FlowField::unreached;
+
+int FlowField::getNextCell(int x, int y) const {
+   const std::uint8_t dist = getDistance(x, y);
+   if (dist == 0 || dist == unreached) return -1;
+   const int neighbors[][2] = {{x - 1, y}, {x + 1, y}, {x, y - 1}, {x, y + 1}};
+   for (const auto& next : neighbors) {
+      if (next[0] < 0 || next[0] >= width || next[1] < 0 || next[1] >= height) continue;
+      if (getDistance(next[0], next[1]) == dist - 1) return width * next[1] + next[0];
+   }
+   return -1;  // Can't happen; a tile is reached from a neighbor.
+}
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,80 @@
+#ifndef FLOW_FIELD_HPP_6RDK2VQM
+#define FLOW_FIELD_HPP_6RDK2VQM
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint8_t
+#include <vector>   // vector
+
+// The distance to the closest of a set of sources for every tile of a grid, measured in
+// steps between open tiles.  Computed by one breadth-first search from all sources at
+// once, so any number of animals can look up how far the closest food is and which way
+// it is in constant time, instead of each of them searching on its own.
+class FlowField {
+  public:
+   // Tiles further away from every source than the search went.
+   static constexpr std::uint8_t unreached = 255;
+
+   // Search from `sources` (cell indices, i.e. `width * y + x`) up to `maxDist` steps.
+   // Only tiles for which `isOpen(x, y)` is true are entered; sources have to be open.
+   // Returns the number of tiles visited.
+   template <typename IsOpen>
+   std::size_t compute(int width, int height, const std::vector<int>& sources,
+                       int maxDist, IsOpen isOpen);
+
+   std::uint8_t getDistance(int x, int y) const { return distances[width * y + x]; }
+
+   // A neighbor of (x, y) that's one step closer to a source, as a cell index, or -1 if
+   // (x, y) is a source or wasn't reached.
+   int getNextCell(int x, int y) const;
+
+   // The memory held by the field, including its scratch space.
+   std::size_t bytesUsed() const {
+      return distances.capacity() + frontier.capacity() * sizeof(int);
+   }
+
+  private:
+   int width = 0;
+   int height = 0;
+   std::vector<std::uint8_t> distances;
+   std::vector<int> frontier;  // Scratch space; cell indices.
+};
+
+template <typename IsOpen>
+std::size_t FlowField::compute(int width, int height, const std::vector<int>& sources,
+                               int maxDist, IsOpen isOpen) {
+   this->width = width;
+   this->height = height;
+   distances.assign(static_cast<std::size_t>(width) * height, unreached);
+   frontier.clear();
+   for (int cell : sources) {
+      if (distances[cell] != 0) {
+         distances[cell] = 0;
+         frontier.push_back(cell);
+      }
+   }
+   // `frontier` holds the tiles at the current distance followed by the next ones.
+   std::size_t begin = 0;
+   for (int dist = 1; dist <= maxDist && begin != frontier.size(); ++dist) {
+      const std::size_t end = frontier.size();
+      for (std::size_t i = begin; i < end; ++i) {
+         const int cell = frontier[i];
+         const int x = cell % width, y = cell / width;
+         const int neighbors[][2] = {{x - 1, y}, {x + 1, y}, {x, y - 1}, {x, y + 1}};
+         for (const auto& next : neighbors) {
+            if (next[0] < 0 || next[0] >= width || next[1] < 0 || next[1] >= height) {
+               continue;
+            }
+            std::uint8_t& nextDist = distances[width * next[1] + next[0]];
+            if (nextDist != unreached || !isOpen(next[0], next[1])) continue;
+            nextDist = static_cast<std::uint8_t>(dist);
+            frontier.push_back(width * next[1] + next[0]);
+         }
+      }
+      begin = end;
+   }
+   return frontier.size();
+}
+
+#endif  // FLOW_FIELD_HPP_6RDK2VQM
+
+// vim: tw=90 sts=-1 sw=3 et
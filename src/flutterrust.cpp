@@ -1,3 +1,4 @@
+#include <cstdlib>  // getenv
 #include <string>
 #include <typeinfo>  // typeid
 
@@ -8,10 +9,12 @@
 
 #include "creature.hpp"
 #include "main_frame.hpp"
+#include "trace.hpp"
 
 class App : public wxApp {
   public:
    virtual bool OnInit() override;
+   virtual int OnExit() override;
 
   private:
    MainFrame* mainFrame;
@@ -23,6 +26,12 @@ bool App::OnInit() {
    SetAppName(u8"flutterrust");
    SetAppDisplayName(u8"flutterrust");
 
+#ifdef TRACE
+   // Write the trace to the file named by FLUTTERRUST_TRACE or to "trace.json".
+   const char* tracePath = std::getenv("FLUTTERRUST_TRACE");
+   trace::start(tracePath ? tracePath : u8"trace.json");
+#endif
+
    const wxFileName exeFileName{wxStandardPaths::Get().GetExecutablePath()};
    const std::string exePath = exeFileName.GetPath().ToStdString();
    try {
@@ -48,4 +57,16 @@ bool App::OnInit() {
    return true;  // Continue processing.
 }
 
+int App::OnExit() {
+#ifdef TRACE
+   try {
+      trace::stop();
+   } catch (const std::exception& e) {
+      wxMessageDialog(nullptr, e.what(), u8"Couldn't write trace", wxICON_ERROR | wxOK)
+          .ShowModal();
+   }
+#endif
+   return wxApp::OnExit();
+}
+
 // vim: tw=90 sts=3 sw=3 et
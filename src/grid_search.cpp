@@ -0,0 +1,79 @@
+#include "grid_search.hpp"
+
+#include <algorithm>  // fill, max, min
+#include <cassert>    // assert
+
+constexpr int GridSearch::unbounded;
+constexpr int GridSearch::dynamicRadius;
+
+namespace {
+template <typename T>
+void release(std::vector<T>& v) {
+   v.clear();
+   v.shrink_to_fit();
+}
+}
+
+GridSearch::Window GridSearch::Window::around(const Window& window, const Pos& center,
+                                              int radius) {
+   const std::int64_t left = std::max(window.origin[0], center[0] - radius);
+   const std::int64_t top = std::max(window.origin[1], center[1] - radius);
+   const std::int64_t right =
+       std::min(window.origin[0] + window.width, center[0] + radius + 1);
+   const std::int64_t bottom =
+       std::min(window.origin[1] + window.height, center[1] + radius + 1);
+   return Window{{{left, top}},
+                 static_cast<int>(std::max<std::int64_t>(0, right - left)),
+                 static_cast<int>(std::max<std::int64_t>(0, bottom - top))};
+}
+
+void GridSearch::begin(const Window& window, const Pos& start) {
+   assert(window.contains(start));
+   this->window = window;
+   const std::size_t size = static_cast<std::size_t>(window.width) * window.height;
+   if (marks.size() < size) {
+      marks.resize(size, 0);
+      costs.resize(size);
+      previous.resize(size);
+   }
+   if (++searchNumber == 0) {
+      // The numbers wrapped around; forget all marks.
+      std::fill(marks.begin(), marks.end(), 0);
+      searchNumber = 1;
+   }
+   startIndex = window.getIndex(start);
+   marks[startIndex] = searchNumber;
+   costs[startIndex] = 0;
+   queue.clear();
+   head = 0;
+   heap.clear();
+}
+
+void GridSearch::getPath(Pos pos, std::vector<Pos>& path) const {
+   assert(isReached(pos));
+   path.clear();
+   std::size_t index = window.getIndex(pos);
+   path.push_back(pos);
+   while (index != startIndex) {
+      index = previous[index];
+      path.push_back(window.getPos(index));
+   }
+}
+
+std::size_t GridSearch::bytesUsed() const {
+   return marks.capacity() * sizeof(std::uint32_t) + costs.capacity() * sizeof(unsigned) +
+          previous.capacity() * sizeof(std::uint32_t) + queue.capacity() * sizeof(Pos) +
+          heap.capacity() * sizeof(HeapEntry);
+}
+
+void GridSearch::release() {
+   ::release(marks);
+   ::release(costs);
+   ::release(previous);
+   ::release(queue);
+   ::release(heap);
+   // Released marks are forgotten.
+   searchNumber = 0;
+}
+
+// vim: tw=90 sts=-1 sw=3 et
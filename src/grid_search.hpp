@@ -0,0 +1,198 @@
+#ifndef GRID_SEARCH_HPP_K2RV9TXC
+#define GRID_SEARCH_HPP_K2RV9TXC
+
+#include <algorithm>    // pop_heap, push_heap
+#include <array>        // array
+#include <cstddef>      // size_t
+#include <cstdint>      // int64_t, uint32_t
+#include <type_traits>  // integral_constant
+#include <utility>      // pair
+#include <vector>       // vector
+
+// Searches of the tile grid from one start position, moving between the four neighbors of
+// each tile.  All searches share one loop, which is assembled at compile time from
+// policies, so each kind of search only pays for what it uses:
+//
+// - The window: the rectangle of tiles the search may enter, e.g. the cached terrain.
+// - Passability: `bool passable(const Pos&)`, e.g. whether a tile has the medium of the
+//   start.
+// - The cost model: `int cost(const Pos&)`, the cost of entering a tile (negative if it
+//   can't be entered), and `int cost.estimate(const Pos&)`, a lower bound of the cost
+//   from a tile to the goal.  Models whose `isUniform` is set, like `UnitCost`, make the
+//   search a breadth-first search with a FIFO queue; others make it A* with a binary
+//   heap.
+// - The radius: positions are only expanded while their cost is below it.  Pass it as
+//   the template argument, or `dynamicRadius` to pass it at run time, or `unbounded`.
+// - The goal and the output: `Action visit(const Pos&, unsigned cost)` is called when a
+//   position leaves the frontier and decides whether to expand it, skip it or stop the
+//   search; `void reach(const Pos&, unsigned cost)` is called whenever a cheaper way to a
+//   position was found.  They collect matches or positions; the reached positions (a
+//   bitmask over the window) and the tree of cheapest paths are kept by the search until
+//   the next one starts.
+//
+// The memory of the searches is reused, so they don't allocate once the buffers are
+// large enough.  Reached positions are marked with the number of the search rather than
+// a flag, so the marks never need to be cleared.
+class GridSearch {
+  public:
+   using Pos = std::array<std::int64_t, 2>;
+
+   enum class Action { expand, skip, stop };
+
+   // Special radii.
+   static constexpr int unbounded = -1;
+   static constexpr int dynamicRadius = -2;
+
+   struct Window {
+      Pos origin;  // The top-left position.
+      int width, height;
+
+      // The part of `window` within a distance of `radius` of `center` in both axes.
+      static Window around(const Window& window, const Pos& center, int radius);
+
+      bool contains(const Pos& pos) const {
+         return pos[0] >= origin[0] && pos[0] < origin[0] + width &&
+                pos[1] >= origin[1] && pos[1] < origin[1] + height;
+      }
+      std::size_t getIndex(const Pos& pos) const {
+         return static_cast<std::size_t>(pos[1] - origin[1]) * width +
+                static_cast<std::size_t>(pos[0] - origin[0]);
+      }
+      Pos getPos(std::size_t index) const {
+         return {{origin[0] + static_cast<std::int64_t>(index % width),
+                  origin[1] + static_cast<std::int64_t>(index / width)}};
+      }
+   };
+
+   // Every step costs 1.
+   struct UnitCost {
+      static constexpr bool isUniform = true;
+      int operator()(const Pos&) const { return 1; }
+      int estimate(const Pos&) const { return 0; }
+   };
+
+   // The passability of tiles that are only limited by the window and the cost model.
+   struct AnyTile {
+      bool operator()(const Pos&) const { return true; }
+   };
+
+   // For searches that don't care about cheaper ways to positions.
+   struct IgnoreReach {
+      void operator()(const Pos&, unsigned) const {}
+   };
+
+   // Search from `start`, which has to be in `window`.  `maxCost` is the radius if
+   // `radius` is `dynamicRadius`.
+   template <int radius, typename Cost, typename Passable, typename Visit, typename Reach>
+   void run(const Window& window, const Pos& start, const Cost& cost,
+            const Passable& passable, const Visit& visit, const Reach& reach,
+            int maxCost = radius);
+
+   // Whether the last search reached `pos`.
+   bool isReached(const Pos& pos) const {
+      return window.contains(pos) && marks[window.getIndex(pos)] == searchNumber;
+   }
+   // The cost of the cheapest way the last search found to the reached `pos`.
+   unsigned getCost(const Pos& pos) const { return costs[window.getIndex(pos)]; }
+   // The path to the reached `pos` along the cheapest ways the last search found.  The
+   // first element is `pos`, the last one the start.
+   void getPath(Pos pos, std::vector<Pos>& path) const;
+
+   // The memory held by the buffers.
+   std::size_t bytesUsed() const;
+   // Free all memory.
+   void release();
+
+  private:
+   using Uniform = std::integral_constant<bool, true>;
+   using Weighted = std::integral_constant<bool, false>;
+   using HeapEntry = std::pair<int, Pos>;  // Priority-position pair.
+
+   struct HeapCompare {
+      // The entry with the smallest priority comes first.
+      bool operator()(const HeapEntry& lhs, const HeapEntry& rhs) const {
+         return lhs.first > rhs.first;
+      }
+   };
+
+   // Prepare the buffers for a search of `window` from `start`.
+   void begin(const Window& window, const Pos& start);
+
+   void push(Uniform, const Pos& pos, int) { queue.push_back(pos); }
+   void push(Weighted, const Pos& pos, int priority) {
+      heap.emplace_back(priority, pos);
+      std::push_heap(heap.begin(), heap.end(), HeapCompare{});
+   }
+   bool isEmpty(Uniform) const { return head == queue.size(); }
+   bool isEmpty(Weighted) const { return heap.empty(); }
+   // The position and the priority it was pushed with; 0 for the queue.
+   HeapEntry pop(Uniform) { return {0, queue[head++]}; }
+   HeapEntry pop(Weighted) {
+      std::pop_heap(heap.begin(), heap.end(), HeapCompare{});
+      const HeapEntry entry = heap.back();
+      heap.pop_back();
+      return entry;
+   }
+
+   Window window{};
+   std::size_t startIndex = 0;
+   std::uint32_t searchNumber = 0;
+   // By index in the window.  `costs` and `previous` are only valid for marked indices.
+   std::vector<std::uint32_t> marks;
+   std::vector<unsigned> costs;
+   std::vector<std::uint32_t> previous;
+   // The frontier: a FIFO queue of positions or a heap.
+   std::vector<Pos> queue;
+   std::size_t head = 0;
+   std::vector<HeapEntry> heap;
+};
+
+template <int radius, typename Cost, typename Passable, typename Visit, typename Reach>
+void GridSearch::run(const Window& window, const Pos& start, const Cost& cost,
+                     const Passable& passable, const Visit& visit, const Reach& reach,
+                     int maxCost) {
+   using Frontier = std::integral_constant<bool, Cost::isUniform>;
+   const int limit = radius == dynamicRadius ? maxCost : radius;
+   begin(window, start);
+   push(Frontier{}, start, 0);
+   while (!isEmpty(Frontier{})) {
+      const HeapEntry entry = pop(Frontier{});
+      const Pos& current = entry.second;
+      const std::size_t index = this->window.getIndex(current);
+      const unsigned currentCost = costs[index];
+      // A position is pushed again whenever a cheaper way to it is found, so it may be in
+      // the heap more than once.  Only the entry of the cheapest way is expanded.
+      if (!Cost::isUniform &&
+          entry.first > static_cast<int>(currentCost) + cost.estimate(current)) {
+         continue;
+      }
+      const Action action = visit(current, currentCost);
+      if (action == Action::stop) break;
+      if (action == Action::skip ||
+          (limit != unbounded && currentCost >= static_cast<unsigned>(limit))) {
+         continue;
+      }
+      static constexpr Pos neighborOffsets[] = {{-1, 0}, {0, -1}, {0, 1}, {1, 0}};
+      for (const auto& offset : neighborOffsets) {
+         const Pos next{current[0] + offset[0], current[1] + offset[1]};
+         if (!this->window.contains(next) || !passable(next)) continue;
+         const int stepCost = cost(next);
+         if (stepCost < 0) continue;
+         const unsigned nextCost = currentCost + stepCost;
+         const std::size_t nextIndex = this->window.getIndex(next);
+         if (marks[nextIndex] == searchNumber && nextCost >= costs[nextIndex]) {
+            // We already have a way to `next` that's just as cheap or cheaper.
+            continue;
+         }
+         marks[nextIndex] = searchNumber;
+         costs[nextIndex] = nextCost;
+         previous[nextIndex] = static_cast<std::uint32_t>(index);
+         reach(next, nextCost);
+         push(Frontier{}, next, static_cast<int>(nextCost) + cost.estimate(next));
+      }
+   }
+}
+
+#endif  // GRID_SEARCH_HPP_K2RV9TXC
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,185 @@
+#include "journal.hpp"
+
+#include <algorithm>  // find, lower_bound, upper_bound
+#include <cassert>    // assert
+#include <istream>    // istream
+#include <iterator>   // begin, end
+#include <ostream>    // ostream
+#include <sstream>    // istringstream, ostringstream
+#include <stdexcept>  // runtime_error
+#include <utility>    // move
+
+#include "trace.hpp"
+
+constexpr int Journal::defaultCheckpointInterval;
+constexpr std::size_t Journal::maxCheckpoints;
+
+namespace {
+const char* const magic = "flutterrust-journal";
+constexpr int version = 2;  // 2 saves the path cache with the state.
+const char* const actionNames[] = {"spawn", "cache", "path"};
+}
+
+Journal::Journal(const World& world, int checkpointInterval)
+    : mapSeed{world.getMapGenerator().getSeed()},
+      seed{world.getSeed()},
+      checkpointInterval{checkpointInterval} {
+   assert(world.getCurrentStep() == 0 && world.creatures.empty());
+   assert(checkpointInterval > 0);
+}
+
+Journal::Journal(std::istream& iStream) {
+   const std::runtime_error invalid{"invalid journal"};
+   std::string word;
+   int fileVersion;
+   std::size_t numActions, numCheckpoints;
+   iStream >> word >> fileVersion >> mapSeed >> seed >> checkpointInterval >> lastStep >>
+       numActions >> numCheckpoints;
+   if (!iStream || word != magic || fileVersion != version || checkpointInterval <= 0) {
+      throw invalid;
+   }
+   for (std::size_t n = 0; n < numActions; ++n) {
+      Action action{};
+      iStream >> action.step >> word;
+      const auto name = std::find(std::begin(actionNames), std::end(actionNames), word);
+      if (name == std::end(actionNames)) throw invalid;
+      action.type = static_cast<ActionType>(name - std::begin(actionNames));
+      if (action.type == ActionType::spawn) {
+         unsigned typeIndex;
+         iStream >> typeIndex >> action.args[0] >> action.args[1];
+         if (typeIndex >= Creature::getTypes().size()) throw invalid;
+         action.typeIndex = static_cast<std::uint8_t>(typeIndex);
+      } else {
+         for (auto& arg : action.args) iStream >> arg;
+      }
+      if (!iStream || action.step > lastStep ||
+          (!actions.empty() && action.step < actions.back().step)) {
+         throw invalid;
+      }
+      actions.push_back(action);
+   }
+   for (std::size_t n = 0; n < numCheckpoints; ++n) {
+      Checkpoint checkpoint;
+      std::size_t size;
+      iStream >> word >> checkpoint.step >> size;
+      if (!iStream || word != "checkpoint" || checkpoint.step <= 0 ||
+          checkpoint.step % checkpointInterval != 0 || checkpoint.step > lastStep ||
+          (!checkpoints.empty() && checkpoint.step <= checkpoints.back().step)) {
+         throw invalid;
+      }
+      iStream.ignore(1);  // The line break.
+      checkpoint.state.resize(size);
+      if (!iStream.read(&checkpoint.state[0], size)) throw invalid;
+      checkpoints.push_back(std::move(checkpoint));
+   }
+}
+
+void Journal::step(World& world) {
+   world.step();
+   lastStep = world.getCurrentStep();
+   if (lastStep % checkpointInterval == 0) {
+      TRACE_ZONE("Journal::checkpoint");
+      std::ostringstream oStream;
+      world.writeState(oStream);
+      if (checkpoints.size() == maxCheckpoints) checkpoints.erase(checkpoints.begin());
+      checkpoints.push_back(Checkpoint{lastStep, oStream.str()});
+   }
+}
+
+bool Journal::spawnCreature(World& world, std::uint8_t typeIndex, std::int64_t x,
+                            std::int64_t y) {
+   actions.push_back(Action{world.getCurrentStep(), ActionType::spawn, typeIndex,
+                            {x, y, 0, 0}});
+   return world.spawnCreature(typeIndex, x, y);
+}
+
+void Journal::updateTerrainCache(World& world, std::int64_t left, std::int64_t top,
+                                 std::int64_t width, std::int64_t height) {
+   // Most calls don't change anything; only record those that do.
+   if (world.isCached(left, top) && world.isCached(left + width, top + height)) return;
+   actions.push_back(Action{world.getCurrentStep(), ActionType::cache, 0,
+                            {left, top, width, height}});
+   apply(world, actions.back());
+}
+
+std::vector<Journal::Pos> Journal::getPath(World& world, Pos start, Pos dest) {
+   actions.push_back(Action{world.getCurrentStep(), ActionType::path, 0,
+                            {start[0], start[1], dest[0], dest[1]}});
+   return world.getPath(start, dest);
+}
+
+void Journal::replay(World& world, int step, bool useCheckpoints) const {
+   TRACE_ZONE("Journal::replay");
+   assert(world.getCurrentStep() == 0 && world.creatures.empty());
+   assert(world.getMapGenerator().getSeed() == mapSeed && world.getSeed() == seed);
+   auto next = actions.begin();
+   if (useCheckpoints) {
+      auto checkpoint = std::upper_bound(
+          checkpoints.begin(), checkpoints.end(), step,
+          [](int step, const Checkpoint& checkpoint) { return step < checkpoint.step; });
+      if (checkpoint != checkpoints.begin()) {
+         --checkpoint;
+         std::istringstream iStream{checkpoint->state};
+         world.readState(iStream);
+         next = std::lower_bound(actions.begin(), actions.end(), checkpoint->step,
+                                 [](const Action& action, int step) {
+                                    return action.step < step;
+                                 });
+      }
+   }
+   while (world.getCurrentStep() < step) {
+      for (; next != actions.end() && next->step == world.getCurrentStep(); ++next) {
+         apply(world, *next);
+      }
+      world.step();
+#ifdef DEBUG
+      const int currentStep = world.getCurrentStep();
+      const auto checkpoint = std::lower_bound(
+          checkpoints.begin(), checkpoints.end(), currentStep,
+          [](const Checkpoint& checkpoint, int step) { return checkpoint.step < step; });
+      if (checkpoint != checkpoints.end() && checkpoint->step == currentStep) {
+         std::ostringstream oStream;
+         world.writeState(oStream);
+         // Otherwise, the simulation isn't deterministic.
+         assert(oStream.str() == checkpoint->state);
+      }
+#endif
+   }
+}
+
+void Journal::write(std::ostream& oStream) const {
+   oStream << magic << ' ' << version << ' ' << mapSeed << ' ' << seed << ' '
+           << checkpointInterval << ' ' << lastStep << ' ' << actions.size() << ' '
+           << checkpoints.size() << '\n';
+   for (const auto& action : actions) {
+      oStream << action.step << ' ' << actionNames[static_cast<int>(action.type)];
+      if (action.type == ActionType::spawn) {
+         oStream << ' ' << unsigned{action.typeIndex} << ' ' << action.args[0] << ' '
+                 << action.args[1];
+      } else {
+         for (auto arg : action.args) oStream << ' ' << arg;
+      }
+      oStream << '\n';
+   }
+   for (const auto& checkpoint : checkpoints) {
+      oStream << "checkpoint " << checkpoint.step << ' ' << checkpoint.state.size()
+              << '\n' << checkpoint.state;
+   }
+}
+
+void Journal::apply(World& world, const Action& action) {
+   const auto& args = action.args;
+   switch (action.type) {
+      case ActionType::spawn:
+         world.spawnCreature(action.typeIndex, args[0], args[1]);
+         break;
+      case ActionType::cache:
+         world.updateTerrainCache(args[0], args[1], args[2], args[3]);
+         break;
+      case ActionType::path:
+         world.getPath({args[0], args[1]}, {args[2], args[3]});
+         break;
+   }
+}
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,94 @@
+#ifndef JOURNAL_HPP_6QF2MZTE
+#define JOURNAL_HPP_6QF2MZTE
+
+#include <cstddef>  // size_t
+#include <cstdint>  // int64_t, uint8_t
+#include <iosfwd>   // istream, ostream
+#include <string>   // string
+#include <vector>   // vector
+
+#include "map_generator.hpp"
+#include "world.hpp"
+
+// A record of everything that was done to a world, from which the world can be replayed
+// exactly: its seeds and, with the step after which they happened, every creature the
+// user spawned, every move of the terrain cache (it decides which creatures are
+// simulated), and every path the user planned (it ends up in the path cache).  Actions
+// are recorded by doing them through the journal.
+//
+// Every `getCheckpointInterval()` steps, the journal saves the world's state, keeping
+// the last `maxCheckpoints` of them.  A replay starts at the last checkpoint before the
+// step it should reach.  Saving leaves the recorded world as it is, and a world reading
+// the state goes on exactly like the one that wrote it (see `World::readState`), so
+// replaying from step 0 reaches the same state as replaying from any checkpoint.
+class Journal {
+  public:
+   using Pos = World::Pos;
+
+   static constexpr int defaultCheckpointInterval = 1000;
+   // Each takes a few megabytes for a busy world.
+   static constexpr std::size_t maxCheckpoints = 8;
+
+   // Start recording `world`, which has to be fresh: it wasn't stepped or changed since
+   // it was constructed.
+   explicit Journal(const World& world,
+                    int checkpointInterval = defaultCheckpointInterval);
+
+   // Read a journal written by `write`.  Throws `std::runtime_error` if it's invalid.
+   explicit Journal(std::istream&);
+
+   // Do the action to `world` and record it.
+   void step(World& world);
+   // Returns whether the creature was spawned (see `World::spawnCreature`).
+   bool spawnCreature(World& world, std::uint8_t typeIndex, std::int64_t x,
+                      std::int64_t y);
+   void updateTerrainCache(World& world, std::int64_t left, std::int64_t top,
+                           std::int64_t width, std::int64_t height);
+   std::vector<Pos> getPath(World& world, Pos start, Pos dest);
+
+   MapGenerator::SeedType getMapSeed() const { return mapSeed; }
+   World::SeedType getSeed() const { return seed; }
+   int getCheckpointInterval() const { return checkpointInterval; }
+   // The last step that was recorded.
+   int getLastStep() const { return lastStep; }
+
+   // Bring `world` to the state the recorded world was in after step `step`, before any
+   // of the actions following it.  `world` has to be fresh and created with the seeds of
+   // the journal; it's stepped as far as necessary, also past the last recorded step.
+   // Starts from the last checkpoint before `step` if `useCheckpoints` is set.
+   void replay(World& world, int step, bool useCheckpoints = true) const;
+
+   // One header line, one line per action, and the checkpoints as blocks of text.
+   void write(std::ostream&) const;
+
+  private:
+   enum class ActionType : std::uint8_t { spawn, cache, path };
+
+   struct Action {
+      int step;
+      ActionType type;
+      std::uint8_t typeIndex;  // Of the spawned creature.
+      // The spawn position; the area to cache (left, top, width, height); or the start
+      // and destination of the path.
+      std::int64_t args[4];
+   };
+
+   struct Checkpoint {
+      int step;
+      std::string state;  // Written by `World::writeState`.
+   };
+
+   // Do `action` to `world` without recording it.
+   static void apply(World& world, const Action& action);
+
+   MapGenerator::SeedType mapSeed;
+   World::SeedType seed;
+   int checkpointInterval;
+   int lastStep = 0;
+   std::vector<Action> actions;  // In the order they happened.
+   std::vector<Checkpoint> checkpoints;  // The last ones, in the order they were saved.
+};
+
+#endif  // JOURNAL_HPP_6QF2MZTE
+
+// vim: tw=90 sts=-1 sw=3 et
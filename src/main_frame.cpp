@@ -3,16 +3,26 @@
 #include <algorithm>  // std::replace, std::max
 #include <array>
 #include <cstddef>     // size_t
-#include <cstdint>     // int64_t
+#include <cstdint>     // int64_t, uint32_t, uint64_t
+#include <cstdlib>     // getenv, strtoull
+#include <fstream>     // std::ofstream
 #include <functional>  // bind
 #include <sstream>     // std::stringstream
+#include <utility>     // move
+#include <vector>      // vector
 
 #include <wx/colour.h>    // wxColour
-#include <wx/dcbuffer.h>  // wxAutoBufferedPaintDC
+#include <wx/dcclient.h>  // wxPaintDC
+#include <wx/filedlg.h>   // wxFileDialog
 #include <wx/filename.h>  // wxFileName
+#include <wx/log.h>       // wxLogError, wxLogWarning
+#include <wx/msgdlg.h>    // wxMessageBox
+#include <wx/rawbmp.h>    // wxNativePixelData
 #include <wx/statline.h>  // wxStaticLine
 
 #include "creature.hpp"
+#include "targa.hpp"
+#include "trace.hpp"
 #include "tuple_helpers.hpp"  // toUT
 
 #include <cassert>  // assert
@@ -26,6 +36,47 @@
 namespace c4o = std::chrono;
 #endif
 
+namespace {
+// Decode a TGA file into a sprite on the thread pool.  A file that fails to load is
+// logged and becomes an empty sprite, which draws nothing.
+std::future<Sprite> loadSprite(ThreadPool& threadPool, const wxString& filePath) {
+   std::string fileName{filePath.fn_str()};
+   return threadPool.submit([fileName]() {
+      try {
+         return Sprite{loadTarga(fileName)};
+      } catch (const std::exception& e) {
+         // wxLog buffers messages from other threads for the main thread.
+         wxLogError("Couldn't load \"%s\": %s", fileName.c_str(), e.what());
+         return Sprite{};
+      }
+   });
+}
+
+// Copy `width` x `height` pixels stored row by row as 0xRRGGBB to `bitmap`, which is
+// recreated if its size differs.  Returns false if the bitmap's pixels can't be accessed.
+bool copyToBitmap(const std::uint32_t* pixels, int width, int height, wxBitmap& bitmap) {
+   if (!bitmap.IsOk() || bitmap.GetWidth() != width || bitmap.GetHeight() != height) {
+      bitmap.Create(width, height, 24);
+   }
+   // The raw access has to end before the bitmap can be drawn, i.e. when we return.
+   wxNativePixelData data{bitmap};
+   if (!data) return false;
+   auto it = data.GetPixels();
+   for (int y = 0; y < height; ++y) {
+      const auto rowStart = it;
+      const std::uint32_t* row = pixels + std::size_t(y) * width;
+      for (int x = 0; x < width; ++x, ++it) {
+         it.Red() = static_cast<std::uint8_t>(row[x] >> 16);
+         it.Green() = static_cast<std::uint8_t>(row[x] >> 8);
+         it.Blue() = static_cast<std::uint8_t>(row[x]);
+      }
+      it = rowStart;
+      it.OffsetY(data, 1);
+   }
+   return true;
+}
+}
+
 MainFrame::MainFrame(const std::string& dataDir, const wxPoint& pos, const wxSize& size)
     : wxFrame{nullptr, wxID_ANY, u8"flutterrust", pos, size},
       menuBar{new wxMenuBar{}},
@@ -51,7 +102,19 @@ MainFrame::MainFrame(const std::string& dataDir, const wxPoint& pos, const wxSiz
       waterContextMenu{new wxMenu{}},
       landContextMenu{new wxMenu{}},
       stepTimer{this},
-      world{} {
+      minimapFrame{new wxFrame{this, wxID_ANY, u8"Minimap"}},
+      minimapPanel{new wxPanel{minimapFrame}},
+      world{},
+      minimap{world.getMapGenerator()},
+      journal{world} {
+   // A soft cap on the memory of the simulation in MiB (see `World::setMemoryCap`).
+   if (const char* memoryCap = std::getenv("FLUTTERRUST_MEMORY_CAP")) {
+      world.setMemoryCap(std::strtoull(memoryCap, nullptr, 10) << 20);
+   }
+   // Start decoding the terrain graphics, the carcass, and the path marker in parallel.
+   // They are needed for the first frame; the remaining setup overlaps with decoding.
+   std::array<std::future<Sprite>, 6> terrainFutures;
+   std::future<Sprite> carcassFuture, pathFuture;
    {
       const std::array<std::string, 6> fileNames{
           u8"deep_sea", u8"shallow_water", u8"sand", u8"earth", u8"rocks", u8"snow"};
@@ -60,46 +123,52 @@ MainFrame::MainFrame(const std::string& dataDir, const wxPoint& pos, const wxSiz
       filePath.AppendDir(u8"terrain");
       for (std::size_t i = 0; i < fileNames.size(); ++i) {
          filePath.SetName(fileNames[i]);
-         terrainBitmaps[i].LoadFile(filePath.GetFullPath(), wxBITMAP_TYPE_TGA);
+         terrainFutures[i] = loadSprite(assetLoader, filePath.GetFullPath());
       }
    }
-   // Load the graphics used for creatures.  The bitmaps can be accessed using the indices
-   // returned by Creature::getTypeIndex().
+   // Creature graphics are only decoded once a creature of their type is placed or drawn
+   // (see `requestCreatureSprite`).  Only remember where they are.  The sprites can be
+   // accessed using the indices returned by Creature::getTypeIndex().
    {
-      creatureBitmaps.reserve(Creature::getTypes().size());
+      creatureSprites.resize(Creature::getTypes().size());
       // Construct a directory path.  The second argument would be the file name and only
       // makes sure the constructor that will consider dataDir to be a directory is
       // chosen.
       wxFileName filePath{dataDir, "", wxPATH_NATIVE};
       filePath.AppendDir(u8"icons");
-      for (const auto& creatureType : Creature::getTypes()) {
+      for (std::size_t i = 0; i < creatureSprites.size(); ++i) {
+         const auto& creatureType = Creature::getTypes()[i];
          // Construct a wxFileName from a unixy path string like 'wasser/algen.tga'.
          wxFileName subPath{creatureType.getBitmapName(), wxPATH_UNIX};
-         // Concatenate the paths and create a bitmap.  Both strings implicitly use the
-         // platform's native format.
-         creatureBitmaps.emplace_back(
+         // Concatenate the paths.  Both strings implicitly use the platform's native
+         // format.
+         creatureSprites[i].filePath =
              filePath.GetPath(wxPATH_GET_VOLUME | wxPATH_GET_SEPARATOR) +
-             subPath.GetFullPath());
+             subPath.GetFullPath();
          // Unrelated to the other code in this loop: set up context menus for placing
          // creatures.
          creatureChoice->Append(creatureType.getName());
       }
       // Load the bitmap used for carcasses.
       filePath.SetFullName(u8"dead.tga");
-      carcassBitmap.LoadFile(filePath.GetFullPath());
-      // creatureBitmaps.emplace_back(filePath.GetFullPath());
+      carcassFuture = loadSprite(assetLoader, filePath.GetFullPath());
    }
    // Load the graphic used to visualize paths for testing.
    {
       wxFileName filePath{dataDir, u8"path.tga", wxPATH_NATIVE};
       filePath.AppendDir(u8"icons");
-      pathBitmap.LoadFile(filePath.GetFullPath());
+      pathFuture = loadSprite(assetLoader, filePath.GetFullPath());
    }
 
    wxWindowID myID_VIEW_CREATURES = NewControlId();
+   wxWindowID myID_EXPORT_STATS = NewControlId();
+   wxWindowID myID_SAVE_JOURNAL = NewControlId();
    myID_PLAY_PAUSE = NewControlId();
+   myID_VIEW_MINIMAP = NewControlId();
    {
       auto* fileMenu = new wxMenu{};
+      fileMenu->Append(myID_EXPORT_STATS, "&Export statistics...\tCtrl+E");
+      fileMenu->Append(myID_SAVE_JOURNAL, "Save &journal...\tCtrl+J");
       fileMenu->Append(wxID_EXIT, "&Quit\tCtrl+Q");
       menuBar->Append(fileMenu, "&File");
       auto* editMenu = new wxMenu{};
@@ -108,6 +177,7 @@ MainFrame::MainFrame(const std::string& dataDir, const wxPoint& pos, const wxSiz
       menuBar->Append(editMenu, "&Edit");
       auto* viewMenu = new wxMenu{};
       viewMenu->AppendCheckItem(myID_VIEW_CREATURES, "&Species info\tS");
+      viewMenu->AppendCheckItem(myID_VIEW_MINIMAP, "&Minimap\tM");
       menuBar->Append(viewMenu, "&View");
    }
    SetMenuBar(menuBar);
@@ -172,8 +242,23 @@ MainFrame::MainFrame(const std::string& dataDir, const wxPoint& pos, const wxSiz
            }
         },
         myID_VIEW_CREATURES);
+   Bind(wxEVT_COMMAND_MENU_SELECTED,
+        [this](wxCommandEvent&) {
+           if (minimapFrame->IsShown()) {
+              minimapFrame->Hide();
+              minimapTimer.Stop();
+           } else {
+              minimapFrame->Show();
+              recenterMinimap();
+              sendCreaturesToMinimap();
+              minimapTimer.Start(100);
+           }
+        },
+        myID_VIEW_MINIMAP);
    Bind(wxEVT_COMMAND_MENU_SELECTED, &MainFrame::onStep, this, wxID_FORWARD);
    Bind(wxEVT_COMMAND_MENU_SELECTED, &MainFrame::onPlayPause, this, myID_PLAY_PAUSE);
+   Bind(wxEVT_COMMAND_MENU_SELECTED, &MainFrame::onExportStats, this, myID_EXPORT_STATS);
+   Bind(wxEVT_COMMAND_MENU_SELECTED, &MainFrame::onSaveJournal, this, myID_SAVE_JOURNAL);
 
    // ...
    controlsBox->Bind(wxEVT_LEFT_DCLICK, &MainFrame::toggleControlsBox, this);
@@ -190,8 +275,49 @@ MainFrame::MainFrame(const std::string& dataDir, const wxPoint& pos, const wxSiz
 
    Bind(wxEVT_TIMER, &MainFrame::onTimer, this);
 
+   // The minimap is a separate window, which is hidden until it's chosen from the menu.
+   // Its timer notifies the panel, so it doesn't trigger `onTimer`.
+   minimapFrame->SetClientSize(512, 512);
+   minimapPanel->SetBackgroundStyle(wxBG_STYLE_PAINT);
+   minimapPanel->Bind(wxEVT_PAINT, &MainFrame::onMinimapPaint, this);
+   minimapPanel->Bind(wxEVT_LEFT_DOWN, &MainFrame::onMinimapClick, this);
+   minimapTimer.SetOwner(minimapPanel);
+   minimapPanel->Bind(wxEVT_TIMER, &MainFrame::onMinimapTimer, this);
+   // Closing the window only hides it.
+   minimapFrame->Bind(wxEVT_CLOSE_WINDOW, [this](wxCloseEvent& event) {
+      if (!event.CanVeto()) {
+         event.Skip();
+         return;
+      }
+      minimapFrame->Hide();
+      minimapTimer.Stop();
+      menuBar->Check(myID_VIEW_MINIMAP, false);
+   });
+
    creatureChoice->SetSelection(0);
    updateAttributes(0);
+
+   for (std::size_t i = 0; i < terrainFutures.size(); ++i) {
+      terrainSprites[i] = terrainFutures[i].get();
+   }
+   carcassSprite = carcassFuture.get();
+   pathSprite = pathFuture.get();
+}
+
+void MainFrame::requestCreatureSprite(std::size_t typeIndex) {
+   auto& lazySprite = creatureSprites[typeIndex];
+   if (!lazySprite.future.valid()) {
+      lazySprite.future = loadSprite(assetLoader, lazySprite.filePath).share();
+   }
+}
+
+const Sprite& MainFrame::getCreatureSprite(std::size_t typeIndex) {
+   auto& lazySprite = creatureSprites[typeIndex];
+   if (!lazySprite.sprite) {
+      requestCreatureSprite(typeIndex);
+      lazySprite.sprite = &lazySprite.future.get();
+   }
+   return *lazySprite.sprite;
 }
 
 void MainFrame::updateAttributes(std::size_t creatureIndex) {
@@ -232,11 +358,14 @@ void MainFrame::toggleControlsBox(wxMouseEvent&) {
 
 // Process a wxEVT_PAINT event.
 void MainFrame::onPaint(wxPaintEvent&) {
+   TRACE_ZONE("MainFrame::onPaint");
 #ifdef DEBUG
    auto startTime = c4o::high_resolution_clock::now();
 #endif
 
-   wxAutoBufferedPaintDC dC{worldPanel};  // Prevents tearing.
+   // Everything is composed in memory and blitted at once, so there's no tearing even
+   // without a buffered DC.
+   wxPaintDC dC{worldPanel};
    int panelWidth, panelHeight;
    dC.GetSize(&panelWidth, &panelHeight);
 
@@ -269,8 +398,9 @@ void MainFrame::onPaint(wxPaintEvent&) {
    // terrain cache if necessary.  Querying terrain outside of the cached area results in
    // invalid array accesses and probably crashes the program (no bounds-checking is
    // performed).  Creatures outside of the cached area are not simulated.
-   world.updateTerrainCache(initialWorldX, worldY, (panelWidth + tileSize - 1) / tileSize,
-                            (panelHeight + tileSize - 1) / tileSize);
+   journal.updateTerrainCache(world, initialWorldX, worldY,
+                              (panelWidth + tileSize - 1) / tileSize,
+                              (panelHeight + tileSize - 1) / tileSize);
 
    // Example: assume scrollOffX is (-33).  That means we scrolled 33 pixels to the left
    // (by moving the mouse to the right).  The value of initialWorldX is (-2), but we can
@@ -280,24 +410,25 @@ void MainFrame::onPaint(wxPaintEvent&) {
    if (initialDrawOffsetX > 0) initialDrawOffsetX -= tileSize;
    if (drawOffsetY > 0) drawOffsetY -= tileSize;
 
+   compositor.resize(panelWidth, panelHeight);
    while (drawOffsetY < panelHeight) {
       auto worldX = initialWorldX;
       auto drawOffsetX = initialDrawOffsetX;
       while (drawOffsetX < panelWidth) {
-         auto bitmapIndex = toUT(world.getTileType(worldX, worldY));
-         assert(bitmapIndex < terrainBitmaps.size());
-         dC.DrawBitmap(terrainBitmaps[bitmapIndex], drawOffsetX, drawOffsetY);
+         const int x = static_cast<int>(drawOffsetX), y = static_cast<int>(drawOffsetY);
+         auto spriteIndex = toUT(world.getTileType(worldX, worldY));
+         assert(spriteIndex < terrainSprites.size());
+         compositor.draw(terrainSprites[spriteIndex], x, y);
          // Draw any carcass that is at {worldX, worldY}.
          if (world.carcasses.find({worldX, worldY}) != world.carcasses.end()) {
-            dC.DrawBitmap(carcassBitmap, drawOffsetX, drawOffsetY);
+            compositor.draw(carcassSprite, x, y);
          }
          // Draw any creatures that are at {worldX, worldY}.
          auto range = world.creatures.equal_range({worldX, worldY});
          for (auto it = range.first; it != range.second; ++it) {
             // const auto& pos = it->first;
             const auto& creature = it->second;
-            dC.DrawBitmap(creatureBitmaps[creature.getTypeIndex()], drawOffsetX,
-                          drawOffsetY);
+            compositor.draw(getCreatureSprite(creature.getTypeIndex()), x, y);
          }
          ++worldX;
          drawOffsetX += tileSize;
@@ -307,9 +438,11 @@ void MainFrame::onPaint(wxPaintEvent&) {
    }
 
    for (const auto& pos : testPath) {
-      dC.DrawBitmap(pathBitmap, worldToPanelX(pos[0]), worldToPanelY(pos[1]));
+      compositor.draw(pathSprite, worldToPanelX(pos[0]), worldToPanelY(pos[1]));
    }
 
+   presentFrame(dC);
+
 #ifdef DEBUG
    auto endTime = c4o::high_resolution_clock::now();
    auto duration = c4o::duration_cast<c4o::milliseconds>(endTime - startTime).count();
@@ -317,6 +450,77 @@ void MainFrame::onPaint(wxPaintEvent&) {
 #endif
 }
 
+void MainFrame::presentFrame(wxDC& dC) {
+   TRACE_ZONE("MainFrame::presentFrame");
+   const int width = compositor.getWidth(), height = compositor.getHeight();
+   if (width <= 0 || height <= 0) return;
+   if (!copyToBitmap(compositor.row(0), width, height, frameBitmap)) return;
+   dC.DrawBitmap(frameBitmap, 0, 0);
+}
+
+void MainFrame::recenterMinimap() {
+   if (!minimapFrame->IsShown()) return;
+   const World::Pos center = getViewCenter();
+   minimap.setCenter(center[0], center[1]);
+   minimapPanel->Refresh(false);
+}
+
+void MainFrame::sendCreaturesToMinimap() {
+   if (!minimapFrame->IsShown()) return;
+   // The minimap's thread counts them; copying the positions is all that happens here.
+   std::vector<World::Pos> positions;
+   positions.reserve(world.creatures.size());
+   for (const auto& creatureInfo : world.creatures) {
+      positions.push_back(creatureInfo.first);
+   }
+   minimap.setCreatures(std::move(positions));
+}
+
+void MainFrame::onMinimapPaint(wxPaintEvent&) {
+   TRACE_ZONE("MainFrame::onMinimapPaint");
+   wxPaintDC dC{minimapPanel};
+   int width, height;
+   dC.GetSize(&width, &height);
+   if (width <= 0 || height <= 0) return;
+   // One pixel per tile, centered on the view.
+   const World::Pos center = getViewCenter();
+   const std::int64_t left = center[0] - width / 2, top = center[1] - height / 2;
+   minimapPixels.resize(std::size_t(width) * height);
+   const std::uint64_t version = minimap.getVersion();
+   if (minimap.tryPaint(left, top, width, height, minimapPixels.data()) &&
+       copyToBitmap(minimapPixels.data(), width, height, minimapBitmap)) {
+      minimapVersion = version;
+   }
+   // If the minimap was busy, show the previous picture; `onMinimapTimer` repaints soon,
+   // because the version differs.
+   if (minimapBitmap.IsOk()) dC.DrawBitmap(minimapBitmap, 0, 0);
+   // Outline the area shown in the worldPanel.
+   const wxSize viewSize = worldPanel->GetClientSize();
+   dC.SetPen(*wxWHITE_PEN);
+   dC.SetBrush(*wxTRANSPARENT_BRUSH);
+   dC.DrawRectangle(static_cast<int>(panelToWorldX(0) - left),
+                    static_cast<int>(panelToWorldY(0) - top), viewSize.x / tileSize + 1,
+                    viewSize.y / tileSize + 1);
+}
+
+void MainFrame::onMinimapTimer(wxTimerEvent&) {
+   if (minimap.getVersion() != minimapVersion) minimapPanel->Refresh(false);
+}
+
+void MainFrame::onMinimapClick(wxMouseEvent& event) {
+   const wxSize minimapSize = minimapPanel->GetClientSize();
+   const wxSize viewSize = worldPanel->GetClientSize();
+   const World::Pos center = getViewCenter();
+   const std::int64_t x = center[0] - minimapSize.x / 2 + event.GetX();
+   const std::int64_t y = center[1] - minimapSize.y / 2 + event.GetY();
+   // Put the middle of that tile at the center of the worldPanel.
+   scrollOffX = x * tileSize + tileSize / 2 - viewSize.x / 2;
+   scrollOffY = y * tileSize + tileSize / 2 - viewSize.y / 2;
+   worldPanel->Refresh(false);
+   recenterMinimap();
+   event.Skip();
+}
+
 void MainFrame::onCreatureChoice(wxCommandEvent& event) {
    auto index = event.GetInt();
    updateAttributes(index);
@@ -340,6 +544,33 @@ void MainFrame::onTimer(wxTimerEvent&) { step(); }
 
 void MainFrame::onStep(wxCommandEvent&) { step(); }
 
+void MainFrame::onExportStats(wxCommandEvent&) {
+   wxFileDialog dialog{this, u8"Export statistics", wxEmptyString, u8"steps.csv",
+                       u8"CSV files (*.csv)|*.csv", wxFD_SAVE | wxFD_OVERWRITE_PROMPT};
+   if (dialog.ShowModal() == wxID_CANCEL) return;
+   std::ofstream oStream{dialog.GetPath().ToStdString()};
+   if (!oStream.is_open()) {
+      wxMessageBox(u8"Couldn't open " + dialog.GetPath(), u8"Error", wxICON_ERROR | wxOK,
+                   this);
+      return;
+   }
+   world.stats.writeCsv(oStream);
+}
+
+void MainFrame::onSaveJournal(wxCommandEvent&) {
+   wxFileDialog dialog{this, u8"Save journal", wxEmptyString, u8"flutterrust.journal",
+                       u8"Journals (*.journal)|*.journal",
+                       wxFD_SAVE | wxFD_OVERWRITE_PROMPT};
+   if (dialog.ShowModal() == wxID_CANCEL) return;
+   std::ofstream oStream{dialog.GetPath().ToStdString()};
+   if (!oStream.is_open()) {
+      wxMessageBox(u8"Couldn't open " + dialog.GetPath(), u8"Error", wxICON_ERROR | wxOK,
+                   this);
+      return;
+   }
+   journal.write(oStream);
+}
+
 void MainFrame::onLeftDown(wxMouseEvent& event) {
    assert(!HasCapture());
    CaptureMouse();
@@ -381,6 +612,7 @@ void MainFrame::onMotion(wxMouseEvent& event) {
    oldMousePos.x = event.GetX();
    oldMousePos.y = event.GetY();
    worldPanel->Refresh(false);
+   recenterMinimap();
    event.Skip();
 }
 
@@ -392,7 +624,7 @@ void MainFrame::onShiftMotion(wxMouseEvent& event) {
                        panelToWorldY(leftDownEvent.GetY())};
       World::Pos dest{panelToWorldX(event.GetX()), panelToWorldY(event.GetY())};
       refreshPath();
-      testPath = world.getPath(std::move(start), std::move(dest));
+      testPath = journal.getPath(world, std::move(start), std::move(dest));
       refreshPath();
       oldMousePos.x = event.GetX();
       oldMousePos.y = event.GetY();
@@ -449,6 +681,11 @@ std::int64_t MainFrame::panelToWorldY(int panelY) const {
    return y;
 }
 
+World::Pos MainFrame::getViewCenter() const {
+   const wxSize size = worldPanel->GetClientSize();
+   return {panelToWorldX(size.x / 2), panelToWorldY(size.y / 2)};
+}
+
 wxPoint MainFrame::panelToWorld(wxPoint point) const {
    point.x = panelToWorldX(point.x);
    point.y = panelToWorldY(point.y);
@@ -502,11 +739,13 @@ wxRect MainFrame::getTileArea(int x, int y) const {
 }
 
 void MainFrame::step() {
+   TRACE_ZONE("MainFrame::step");
 #ifdef DEBUG  // {{{1
    auto startTime = c4o::high_resolution_clock::now();
 #endif  // }}}1
 
-   world.step();
+   journal.step(world);
+   sendCreaturesToMinimap();
 
    // This is usually much slower than refreshing individual rectangles and ignoring areas
    // that didn't change for certain.
@@ -554,7 +793,12 @@ void MainFrame::onContextMenuRequested(wxContextMenuEvent& event) {
 void MainFrame::onMenuItemSelected(wxCommandEvent& event) {
    std::int64_t worldX = panelToWorldX(contextMenuPos.x);
    std::int64_t worldY = panelToWorldY(contextMenuPos.y);
-   world.spawnCreature(event.GetId(), worldX, worldY);
+   // Decode the creature's graphic while the event loop gets to the repaint.
+   requestCreatureSprite(event.GetId());
+   if (!journal.spawnCreature(world, event.GetId(), worldX, worldY)) {
+      wxLogWarning(u8"The world uses more memory than FLUTTERRUST_MEMORY_CAP allows; "
+                   u8"no creatures can be placed until some die.");
+   }
    // Invalidate the area of the tile we added a creature to.  It will be repainted during
    // the next event loop iteration.
    worldPanel->RefreshRect(getTileArea(contextMenuPos.x, contextMenuPos.y), false);
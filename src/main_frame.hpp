@@ -4,10 +4,13 @@
 #include <array>
 #include <cstddef>  // size_t
 #include <cstdint>  // int64_t
+#include <future>   // shared_future
 #include <vector>
 
+#include <wx/bitmap.h>  // wxBitmap
 #include <wx/button.h>
 #include <wx/choice.h>
+#include <wx/dc.h>  // wxDC
 #include <wx/frame.h>
 #include <wx/listbox.h>  // wxListBox
 #include <wx/menu.h>     // wxMenuBar
@@ -18,6 +21,10 @@
 #include <wx/textctrl.h>
 #include <wx/timer.h>  // wxTimer
 
+#include "compositor.hpp"
+#include "journal.hpp"
+#include "minimap.hpp"
+#include "thread_pool.hpp"
 #include "world.hpp"
 
 class MainFrame : public wxFrame {
@@ -32,6 +39,8 @@ class MainFrame : public wxFrame {
    int worldToPanelX(std::int64_t worldX) const;
    int worldToPanelY(std::int64_t worldY) const;
    wxRect getTileArea(int x, int y) const;
+   // The position of the tile at the center of the worldPanel.
+   World::Pos getViewCenter() const;
 
    void step();
 
@@ -39,13 +48,35 @@ class MainFrame : public wxFrame {
 
    void updateAttributes(std::size_t creatureIndex);
 
+   // Start decoding the graphic for creatures of the given type unless that already
+   // happened.
+   void requestCreatureSprite(std::size_t typeIndex);
+   // The graphic for creatures of the given type.  Waits for it to be decoded.
+   const Sprite& getCreatureSprite(std::size_t typeIndex);
+
    void toggleControlsBox(wxMouseEvent&);
    void onPaint(wxPaintEvent&);
+   // Copy the frame composed by `compositor` to `frameBitmap` and blit it.
+   void presentFrame(wxDC&);
    void onCreatureChoice(wxCommandEvent&);
    void onPlace(wxCommandEvent&);
    void onPlayPause(wxCommandEvent&);
    void onTimer(wxTimerEvent&);
    void onStep(wxCommandEvent&);
+   // Write the counters of the most recent steps to a CSV file chosen by the user.
+   void onExportStats(wxCommandEvent&);
+   // Write everything done to the world so far to a file chosen by the user, so it can be
+   // replayed without the GUI (see `bench replay`).
+   void onSaveJournal(wxCommandEvent&);
+
+   // If the minimap is shown, center it on the view or update its creature density.
+   void recenterMinimap();
+   void sendCreaturesToMinimap();
+   void onMinimapPaint(wxPaintEvent&);
+   // Repaint the minimap if its background thread made progress.
+   void onMinimapTimer(wxTimerEvent&);
+   // Move the view to the tile that was clicked on the minimap.
+   void onMinimapClick(wxMouseEvent&);
 
    // Process a wxEVT_LEFT_DOWN; captures the mouse.
    void onLeftDown(wxMouseEvent&);
@@ -74,6 +105,7 @@ class MainFrame : public wxFrame {
    std::vector<World::Pos> testPath;
 
    wxWindowID myID_PLAY_PAUSE;
+   wxWindowID myID_VIEW_MINIMAP;
 
    wxMenuBar* menuBar;
    wxPanel* topPanel;
@@ -91,13 +123,33 @@ class MainFrame : public wxFrame {
    wxMenu* waterContextMenu;
    wxMenu* landContextMenu;
    wxTimer stepTimer;
-
-   std::array<wxBitmap, 6> terrainBitmaps;
-   std::vector<wxBitmap> creatureBitmaps;
-   wxBitmap carcassBitmap;
-   wxBitmap pathBitmap;
+   wxFrame* minimapFrame;
+   wxPanel* minimapPanel;
+   wxTimer minimapTimer;
+
+   // A creature graphic that is decoded on first use.
+   struct LazySprite {
+      wxString filePath;
+      std::shared_future<Sprite> future;
+      const Sprite* sprite = nullptr;  // Points into `future` once it's ready.
+   };
+
+   ThreadPool assetLoader;
+   std::array<Sprite, 6> terrainSprites;
+   std::vector<LazySprite> creatureSprites;
+   Sprite carcassSprite;
+   Sprite pathSprite;
+   Compositor compositor;
+   wxBitmap frameBitmap;
+   wxBitmap minimapBitmap;
+   std::vector<std::uint32_t> minimapPixels;
+   std::uint64_t minimapVersion = 0;  // Of the data in `minimapBitmap`.
 
    World world;
+   // Declared after `world`, because it copies the world's `MapGenerator`.
+   Minimap minimap;
+   // Everything that changes `world` goes through here, so it can be replayed.
+   Journal journal;
 };
 
 #endif  // MAIN_FRAME_HPP_JJ6U3B49
@@ -2,7 +2,14 @@
 
 #include <array>
 #include <cassert>  // assert
-#include <cstdint>  // int64_t
+#include <cmath>    // sqrt
+#include <cstdint>  // int64_t, uint64_t
+#include <future>   // future
+#include <random>   // random_device
+#include <vector>   // vector
+
+#include "thread_pool.hpp"
+#include "trace.hpp"
 
 #ifdef DEBUG
 #include <iostream>
@@ -24,70 +31,117 @@ float dotProduct(std::array<float, 2> a, std::array<float, 2> b) {
    return a[0] * b[0] + a[1] * b[1];
 }
 
+namespace {
+
+// Interpolate between the dot products at the top-left, top-right, bottom-left and
+// bottom-right corners of a grid cell.  The weights are the position within the cell.
+float interpolate(const std::array<float, 4>& dots, float xWeight, float yWeight) {
+   float topXAverage = lerp(dots[0], dots[1], xWeight);
+   float bottomXAverage = lerp(dots[2], dots[3], xWeight);
+   return lerp(topXAverage, bottomXAverage, yWeight);
+}
+
+TileType toTileType(float value) {
+   // constexpr float maxVal = std::sqrt(2) / 2;
+   // assert(-maxVal <= value && value <= maxVal);
+   // value += maxVal;      // Transform value into the range [0, 2 * maxValue].
+   // value /= 2 * maxVal;  // Transform it into the range [0, 1].
+
+   // I think my implementation of Perlin noise can result in values in the range
+   // [-maxVal, maxVal].  However, the vast majority of values are much closer to zero, so
+   // the commented out code above doesn't work very well.
+
+   // This should kind of move most values into the range [-2.5, 2.5].
+   value *= 5.f;
+   // Now most should be in the range [0, 5].
+   value += 2.5f;
+   // Treat everything negative as 0 and everything bigger than or equal to 6 as 5.
+   if (value < 0.f) value = 0.f;
+   if (value >= 6.f) value = 5.f;
+   // Now we only have values in [0, 6).  They can be converted to TileType values by
+   // truncating.
+   return static_cast<TileType>(value);
+}
+
+// The finalizer of SplitMix64 [1]: every bit of the input affects every bit of the
+// output, so adjacent lattice points get unrelated gradients.
+// [1]: https://prng.di.unimi.it/splitmix64.c
+std::uint64_t mix(std::uint64_t z) {
+   z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+   z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+   return z ^ (z >> 31);
+}
+
+// Round towards negative infinity.
+std::int64_t floorDiv(std::int64_t a, std::int64_t b) {
+   return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+}  // namespace
+
 MapGenerator::TerrainBlock MapGenerator::getBlock(std::int64_t row,
                                                   std::int64_t col) const {
-   MapGenerator::TerrainBlock terrainBlock;
-
-   // We need size^2 gradient vectors.
-   constexpr std::size_t size = blockSize / gridSize + 1;
+   TerrainBlock terrainBlock;
+   getRegion(row, col, 1, 1, &terrainBlock);
+   return terrainBlock;
+}
 
-   // Assign a random gradient vector of unit length to each grid node.  TODO: we really
-   // only need to store (size + 2) vectors at a time.
-   std::array<std::array<std::array<float, 2>, size>, size> gradients;
-   {
-      // Use the gradient vectors of adjacent blocks for two edges.  Otherwise we would
-      // get visible transitions at block edges, since adjacent tiles would use different
-      // gradient vectors.
-      std::size_t i = size - 1;
-      std::size_t j = 0;
-
-      // Seed of the adjacent block to the bottom.
-      seedRNG(row + 1, col);
-      // Get the random gradients used for the top row of the block to the bottom.  Use
-      // them for this bottom row.
-      for (; j < size - 1; ++j) {
-         gradients[i][j] = getGradient();
+void MapGenerator::getRegion(std::int64_t row, std::int64_t col, std::size_t rows,
+                             std::size_t cols, TerrainBlock* blocks,
+                             ThreadPool* pool) const {
+   TRACE_ZONE("MapGenerator::getRegion");
+   // Look up the gradient vector of each lattice point of the rectangle.  Adjacent blocks
+   // share the points along their edges.
+   constexpr std::size_t cellsPerBlock = blockSize / gridSize;
+   const std::size_t stride = cols * cellsPerBlock + 1;
+   const std::size_t height = rows * cellsPerBlock + 1;
+   std::vector<Gradient> gradients(stride * height);
+   const std::int64_t firstX = col * static_cast<std::int64_t>(cellsPerBlock);
+   const std::int64_t firstY = row * static_cast<std::int64_t>(cellsPerBlock);
+   for (std::size_t y = 0; y < height; ++y) {
+      for (std::size_t x = 0; x < stride; ++x) {
+         gradients[y * stride + x] = getGradient(firstX + static_cast<std::int64_t>(x),
+                                                 firstY + static_cast<std::int64_t>(y));
       }
+   }
 
-      // Seed of the adjacent block to the bottom-right.
-      seedRNG(row + 1, col + 1);
-      assert(j == size - 1);
-      gradients[i][j] = getGradient();
-
-      // Seed of the adjacent block to the right.
-      seedRNG(row, col + 1);
-      i = 0;
-      assert(j == size - 1);
-      gradients[i][j] = getGradient();
-      // Throw the remaining (size - 2) pairs of random numbers for the top row away.
-      rNGen.discard(2 * size - 4);
-      // The next random numbers are those the block to the right uses for its leftmost
-      // column.  Use them for the rightmost column.
-      for (++i; i < size - 1; ++i) {
-         gradients[i][j] = getGradient();
+   auto fill = [&](std::size_t r, std::size_t c) {
+      fillBlock(&gradients[r * cellsPerBlock * stride + c * cellsPerBlock], stride,
+                blocks[r * cols + c]);
+   };
+   if (!pool || rows * cols == 1) {
+      for (std::size_t r = 0; r < rows; ++r) {
+         for (std::size_t c = 0; c < cols; ++c) fill(r, c);
       }
+      return;
    }
-   // Finally, use the seed of this block.
-   seedRNG(row, col);
-   // The gradient vectors for the top row and leftmost column are the ones adjacent
-   // blocks also use.  They are computed first.  Otherwise we would have to waste more
-   // time generating and throwing away random numbers in the code generating gradients of
-   // other blocks above.
-   for (std::size_t j = 0; j < size - 1; ++j) {
-      gradients[0][j] = getGradient();
-   }
-   for (std::size_t j = 0; j < size - 1; ++j) {
-      for (std::size_t i = 1; i < size - 1; ++i) {
-         gradients[i][j] = getGradient();
-      }
+   // One task per row of blocks.
+   std::vector<std::future<void>> rowsDone;
+   rowsDone.reserve(rows);
+   for (std::size_t r = 0; r < rows; ++r) {
+      rowsDone.push_back(pool->submit([&fill, r, cols] {
+         for (std::size_t c = 0; c < cols; ++c) fill(r, c);
+      }));
    }
+   for (auto& rowDone : rowsDone) rowDone.get();
+}
+
+void MapGenerator::fillBlock(const Gradient* gradients, std::size_t stride,
+                             TerrainBlock& terrainBlock) {
+#ifdef DEBUG
+   // The block has size^2 lattice points.
+   constexpr std::size_t size = blockSize / gridSize + 1;
+#endif
+   auto gradientAt = [=](std::size_t x, std::size_t y) -> const Gradient& {
+      return gradients[y * stride + x];
+   };
 
 #ifdef DEBUG  // Assert all the gradients are unit vectors. {{{1
    {
       constexpr float epsilon = 0.01f;
       for (std::size_t i = 0; i < size; ++i) {
          for (std::size_t j = 0; j < size; ++j) {
-            auto& gradient = gradients[i][j];
+            auto& gradient = gradientAt(j, i);
             assert(dotProduct(gradient, gradient) <= 1.f + epsilon);
          }
       }
@@ -105,8 +159,8 @@ MapGenerator::TerrainBlock MapGenerator::getBlock(std::int64_t row,
          std::array<std::size_t, 2> topLeft{j / gridSize, i / gridSize};
 
 #ifdef DEBUG  // Assert use of topLeft to index gradients is correct. {{{1
-         assert(topLeft[0] + 1 < gradients.size());
-         assert(topLeft[1] + 1 < gradients[0].size());
+         assert(topLeft[0] + 1 < size);
+         assert(topLeft[1] + 1 < size);
 #endif  // }}}1
 
          // For each corner of that cell, determine the distance vector from the corner to
@@ -125,10 +179,10 @@ MapGenerator::TerrainBlock MapGenerator::getBlock(std::int64_t row,
          // For each of the 4 distance vectors, compute the dot product between it and the
          // corner's gradient vector.
          std::array<float, 4> dots{
-             dotProduct(distance[0], gradients[topLeft[1]][topLeft[0]]),
-             dotProduct(distance[1], gradients[topLeft[1]][topLeft[0] + 1]),
-             dotProduct(distance[2], gradients[topLeft[1] + 1][topLeft[0]]),
-             dotProduct(distance[3], gradients[topLeft[1] + 1][topLeft[0] + 1])};
+             dotProduct(distance[0], gradientAt(topLeft[0], topLeft[1])),
+             dotProduct(distance[1], gradientAt(topLeft[0] + 1, topLeft[1])),
+             dotProduct(distance[2], gradientAt(topLeft[0], topLeft[1] + 1)),
+             dotProduct(distance[3], gradientAt(topLeft[0] + 1, topLeft[1] + 1))};
 
 #ifdef DEBUG  // ... {{{1
          {
@@ -141,61 +195,36 @@ MapGenerator::TerrainBlock MapGenerator::getBlock(std::int64_t row,
 #endif  // }}}1
 
          // Interpolate between the 4 dot products.
-         float xWeight = point[0] - topLeft[0];
-         float yWeight = point[1] - topLeft[1];
-         float topXAverage = lerp(dots[0], dots[1], xWeight);
-         float bottomXAverage = lerp(dots[2], dots[3], xWeight);
-         float value = lerp(topXAverage, bottomXAverage, yWeight);
-
-         // constexpr float maxVal = std::sqrt(2) / 2;
-         // assert(-maxVal <= value && value <= maxVal);
-         // value += maxVal;      // Transform value into the range [0, 2 * maxValue].
-         // value /= 2 * maxVal;  // Transform it into the range [0, 1].
-
-         // I think my implementation of Perlin noise can result in values in the range
-         // [-maxVal, maxVal].  However, the vast majority of values are much closer to
-         // zero, so the commented out code above doesn't work very well.
-
-         // This should kind of move most values into the range [-2.5, 2.5].
-         value *= 5.f;
-         // Now most should be in the range [0, 5].
-         value += 2.5f;
-         // Treat everything negative as 0 and everything bigger than or equal to 6 as 5.
-         if (value < 0.f) value = 0.f;
-         if (value >= 6.f) value = 5.f;
-         // Now we only have values in [0, 6).  They can be converted to TileType values
-         // by truncating.
-         terrainBlock[i][j] = static_cast<TileType>(value);
+         terrainBlock[i][j] = toTileType(interpolate(dots, point[0] - topLeft[0],
+                                                     point[1] - topLeft[1]));
       }
    }
-   return terrainBlock;
 }
 
-void MapGenerator::seedRNG(std::int64_t i, std::int64_t j) const {
-   // Seed the PRNG.  FIXME: do it in a way that doesn't suck.
-   SeedType blockSeed;
-   if (i <= 0) {
-      blockSeed = (-i) * 2;
-   } else {
-      blockSeed = i * 2 - 1;
-   }
-   blockSeed <<= 16;
-   if (j <= 0) {
-      blockSeed |= (-j) * 2;
-   } else {
-      blockSeed |= j * 2 - 1;
-   }
-   rNGen.seed(blockSeed ^ seed);
-   // Throw some random numbers away.  The first random numbers generated from similar
-   // seeds are also very similar.
-   rNGen.discard(3);
+TileType MapGenerator::getTileType(std::int64_t x, std::int64_t y) const {
+   constexpr auto grid = static_cast<std::int64_t>(gridSize);
+   const std::int64_t cellX = floorDiv(x, grid);
+   const std::int64_t cellY = floorDiv(y, grid);
+   // The position within the grid cell; `getBlock` computes the same values.
+   const std::array<float, 2> point{static_cast<float>(x - cellX * grid) / gridSize,
+                                    static_cast<float>(y - cellY * grid) / gridSize};
+   const std::array<float, 4> dots{
+       dotProduct(point, getGradient(cellX, cellY)),
+       dotProduct({point[0] - 1.f, point[1]}, getGradient(cellX + 1, cellY)),
+       dotProduct({point[0], point[1] - 1.f}, getGradient(cellX, cellY + 1)),
+       dotProduct({point[0] - 1.f, point[1] - 1.f}, getGradient(cellX + 1, cellY + 1))};
+   return toTileType(interpolate(dots, point[0], point[1]));
 }
 
-std::array<float, 2> MapGenerator::getGradient() const {
-   std::array<float, 2> gradient;
-   gradient[0] = rNDist(rNGen);
+MapGenerator::Gradient MapGenerator::getGradient(std::int64_t x, std::int64_t y) const {
+   const std::uint64_t hash = mix(mix(mix(seed) ^ static_cast<std::uint64_t>(x)) ^
+                                  static_cast<std::uint64_t>(y));
+   // The top 24 bits give the x component, uniformly distributed in [-1, 1); the lowest
+   // bit gives the sign of the y component.
+   Gradient gradient;
+   gradient[0] = static_cast<float>(hash >> 40) / (1 << 23) - 1.f;
    gradient[1] = std::sqrt(1 - gradient[0] * gradient[0]);
-   if (coin(rNGen)) gradient[1] = -gradient[1];
+   if (hash & 1) gradient[1] = -gradient[1];
    return gradient;
 }
 
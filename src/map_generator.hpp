@@ -2,19 +2,21 @@
 #define MAP_GENERATOR_HPP_BFBAHR9V
 
 #include <array>
-#include <cmath>    // sqrt
 #include <cstddef>  // size_t
-#include <cstdint>  // int64_t
-#include <random>   // minstd_rand
+#include <cstdint>  // int64_t, uint_fast32_t
 
 #include "tile_type.hpp"
 
-class MapGenerator {
-   using RNGen = std::minstd_rand;  // Meh but cheap, I guess [1].
-   // [1]: http://en.cppreference.com/w/cpp/numeric/random/linear_congruential_engine
+class ThreadPool;
 
+// Generates terrain with Perlin noise.  The gradient at each point of the noise lattice
+// is a hash of the seed and the point's coordinates, so any tile can be computed on its
+// own, and adjacent blocks agree on the gradients along their shared edges without
+// knowing about each other.  There's no mutable state; a generator can be used by several
+// threads at once.
+class MapGenerator {
   public:
-   using SeedType = RNGen::result_type;  // std::uint_fast32_t
+   using SeedType = std::uint_fast32_t;
 
    // The size of terrain blocks that can be requested.
    static constexpr std::size_t blockSize = 64;
@@ -23,19 +25,35 @@ class MapGenerator {
    MapGenerator();
    MapGenerator(SeedType seed);
 
-   // Generate a block of blockSize^2 TileType values.
+   SeedType getSeed() const { return seed; }
+
+   // Generate a block of blockSize^2 TileType values.  Block (i, j) covers the tiles with
+   // y in [i * blockSize, (i + 1) * blockSize) and x in [j * blockSize, (j + 1) *
+   // blockSize).
    TerrainBlock getBlock(std::int64_t i, std::int64_t j) const;
 
+   // Generate the `rows` x `cols` blocks starting at block (i, j) into `blocks`, row by
+   // row: block (i + r, j + c) goes to `blocks[r * cols + c]`.  The gradients are
+   // computed once for the whole rectangle rather than once per block.  If `pool` is
+   // given, its workers fill the blocks, and the call returns once they're done; so it
+   // mustn't be called by one of them.
+   void getRegion(std::int64_t i, std::int64_t j, std::size_t rows, std::size_t cols,
+                  TerrainBlock* blocks, ThreadPool* pool = nullptr) const;
+
+   // Generate the single tile at (x, y), which is the same as in its block.
+   TileType getTileType(std::int64_t x, std::int64_t y) const;
+
   private:
-   // Set the seed of the PRNG to the one used for block (i, j).
-   void seedRNG(std::int64_t i, std::int64_t j) const;
+   using Gradient = std::array<float, 2>;
+
+   // Get the unit vector at the lattice point (x, y).
+   Gradient getGradient(std::int64_t x, std::int64_t y) const;
 
-   // Get a random unit vector.
-   std::array<float, 2> getGradient() const;
+   // Fill `block` from the gradients of its lattice points.  `gradients` points to the
+   // one at its top-left corner; the rows of the lattice are `stride` gradients apart.
+   static void fillBlock(const Gradient* gradients, std::size_t stride,
+                         TerrainBlock& block);
 
-   mutable RNGen rNGen;
-   mutable std::uniform_real_distribution<float> rNDist{-1.f, 1.f};
-   mutable std::uniform_int_distribution<int> coin{0, 1};
    const SeedType seed;
 
    // I stopped using a class template with gridSize as a non-type template parameter
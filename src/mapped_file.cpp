@@ -0,0 +1,39 @@
+#include "mapped_file.hpp"
+
+#include <fcntl.h>     // open
+#include <sys/mman.h>  // mmap, munmap, madvise
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // close
+
+#include <stdexcept>  // runtime_error
+
+MappedFile::MappedFile(const std::string& filePath) {
+   int fd = ::open(filePath.c_str(), O_RDONLY);
+   if (fd == -1) {
+      throw std::runtime_error{u8"couldn't open file " + filePath};
+   }
+   struct stat status;
+   if (::fstat(fd, &status) == -1) {
+      ::close(fd);
+      throw std::runtime_error{u8"couldn't stat file " + filePath};
+   }
+   length = static_cast<std::size_t>(status.st_size);
+   if (length > 0) {
+      void* address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (address == MAP_FAILED) {
+         ::close(fd);
+         throw std::runtime_error{u8"couldn't map file " + filePath};
+      }
+      // We read the file from front to back exactly once.
+      ::madvise(address, length, MADV_SEQUENTIAL);
+      data = static_cast<const char*>(address);
+   }
+   // The mapping stays valid after closing the descriptor.
+   ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+   if (data) ::munmap(const_cast<char*>(data), length);
+}
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,29 @@
+#ifndef MAPPED_FILE_HPP_8JQ2XNAV
+#define MAPPED_FILE_HPP_8JQ2XNAV
+
+#include <cstddef>  // size_t
+#include <string>   // string
+
+// A read-only memory mapping of a whole file (POSIX `mmap`).  Lets parsers work on the
+// file's contents without copying or reading them piecemeal.
+class MappedFile {
+  public:
+   // Throws `std::runtime_error` if the file can't be opened or mapped.
+   explicit MappedFile(const std::string& filePath);
+   ~MappedFile();
+
+   MappedFile(const MappedFile&) = delete;
+   MappedFile& operator=(const MappedFile&) = delete;
+
+   const char* begin() const { return data; }
+   const char* end() const { return data + length; }
+   std::size_t size() const { return length; }
+
+  private:
+   const char* data = nullptr;  // Stays `nullptr` for empty files.
+   std::size_t length = 0;
+};
+
+#endif  // MAPPED_FILE_HPP_8JQ2XNAV
+
+// vim: tw=90 sts=-1 sw=3 et
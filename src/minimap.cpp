@@ -0,0 +1,175 @@
+#include "minimap.hpp"
+
+#include <algorithm>  // max, min, sort
+#include <cstdlib>    // abs
+#include <utility>    // move, swap
+
+#include "trace.hpp"
+#include "tuple_helpers.hpp"  // toUT
+
+constexpr std::int64_t Minimap::radius;
+constexpr std::int64_t Minimap::densityCellSize;
+
+namespace {
+constexpr auto blockSize = static_cast<std::int64_t>(MapGenerator::blockSize);
+
+// Deep water, water, sand, dirt, rock, snow.
+constexpr std::uint32_t tileColors[] = {0x1d3f8a, 0x3e7fd0, 0xe2d39a,
+                                        0x6f9a3c, 0x8a8a8a, 0xf4f4f4};
+static_assert(sizeof(tileColors) / sizeof(*tileColors) == toUT(TileType::SIZE),
+              "a tile type is missing a color");
+
+// Blend `color` towards red; `weight` is in [0, 256].
+std::uint32_t tint(std::uint32_t color, std::uint32_t weight) {
+   const std::uint32_t red = (color >> 16 & 0xff) * (256 - weight) + 0xff * weight;
+   const std::uint32_t green = (color >> 8 & 0xff) * (256 - weight);
+   const std::uint32_t blue = (color & 0xff) * (256 - weight);
+   return (red >> 8) << 16 | (green >> 8) << 8 | blue >> 8;
+}
+
+// Round towards negative infinity.
+std::int64_t floorDiv(std::int64_t a, std::int64_t b) {
+   return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+}
+
+Minimap::Minimap(const MapGenerator& mapGen) : mapGen{mapGen} {
+   for (std::int64_t dy = -radius; dy <= radius; ++dy) {
+      for (std::int64_t dx = -radius; dx <= radius; ++dx) offsets.push_back({dx, dy});
+   }
+   std::sort(offsets.begin(), offsets.end(), [](const Pos& a, const Pos& b) {
+      return std::max(std::abs(a[0]), std::abs(a[1])) <
+             std::max(std::abs(b[0]), std::abs(b[1]));
+   });
+   // Nothing to do until there's a center.
+   nextOffset = offsets.size();
+   worker = std::thread{&Minimap::work, this};
+}
+
+Minimap::~Minimap() {
+   {
+      std::lock_guard<std::mutex> lock{mutex};
+      stopping = true;
+   }
+   wake.notify_one();
+   worker.join();
+}
+
+void Minimap::setCenter(std::int64_t x, std::int64_t y) {
+   const Pos block{floorDiv(x, blockSize), floorDiv(y, blockSize)};
+   {
+      std::lock_guard<std::mutex> lock{mutex};
+      if (hasCenter && block == centerBlock) return;
+      hasCenter = true;
+      centerBlock = block;
+      nextOffset = 0;
+      // Keep a margin, so moving back and forth doesn't generate the same blocks again.
+      constexpr std::int64_t keep = radius + radius / 4;
+      for (auto it = blocks.begin(); it != blocks.end();) {
+         if (std::abs(it->first[0] - block[0]) > keep ||
+             std::abs(it->first[1] - block[1]) > keep) {
+            it = blocks.erase(it);
+         } else {
+            ++it;
+         }
+      }
+   }
+   wake.notify_one();
+}
+
+void Minimap::setCreatures(std::vector<Pos> positions) {
+   {
+      std::lock_guard<std::mutex> lock{mutex};
+      pendingCreatures = std::move(positions);
+      creaturesChanged = true;
+   }
+   wake.notify_one();
+}
+
+void Minimap::work() {
+   std::unique_lock<std::mutex> lock{mutex};
+   while (true) {
+      wake.wait(lock, [this] {
+         return stopping || creaturesChanged || nextOffset != offsets.size();
+      });
+      if (stopping) return;
+      if (creaturesChanged) {
+         TRACE_ZONE("Minimap::countCreatures");
+         std::vector<Pos> positions;
+         positions.swap(pendingCreatures);
+         creaturesChanged = false;
+         lock.unlock();
+         std::unordered_map<Pos, std::uint16_t, PosHash> counts;
+         for (const Pos& pos : positions) {
+            auto& count = counts[{floorDiv(pos[0], densityCellSize),
+                                  floorDiv(pos[1], densityCellSize)}];
+            if (count != UINT16_MAX) ++count;
+         }
+         lock.lock();
+         density.swap(counts);
+         ++version;
+         continue;
+      }
+      const Pos& offset = offsets[nextOffset++];
+      const Pos block{centerBlock[0] + offset[0], centerBlock[1] + offset[1]};
+      if (blocks.count(block)) continue;
+      lock.unlock();
+      const MapGenerator::TerrainBlock terrain = mapGen.getBlock(block[1], block[0]);
+      lock.lock();
+      blocks.emplace(block, terrain);
+      ++version;
+   }
+}
+
+bool Minimap::tryPaint(std::int64_t left, std::int64_t top, int width, int height,
+                       std::uint32_t* pixels) const {
+   std::unique_lock<std::mutex> lock{mutex, std::try_to_lock};
+   if (!lock) return false;
+   TRACE_ZONE("Minimap::tryPaint");
+   const std::int64_t right = left + width, bottom = top + height;
+   // Copy the terrain block by block.
+   for (std::int64_t blockY = floorDiv(top, blockSize); blockY * blockSize < bottom;
+        ++blockY) {
+      for (std::int64_t blockX = floorDiv(left, blockSize); blockX * blockSize < right;
+           ++blockX) {
+         const auto it = blocks.find({blockX, blockY});
+         const std::int64_t x0 = std::max(left, blockX * blockSize);
+         const std::int64_t x1 = std::min(right, (blockX + 1) * blockSize);
+         const std::int64_t y0 = std::max(top, blockY * blockSize);
+         const std::int64_t y1 = std::min(bottom, (blockY + 1) * blockSize);
+         for (std::int64_t y = y0; y < y1; ++y) {
+            std::uint32_t* row = pixels + (y - top) * width;
+            for (std::int64_t x = x0; x < x1; ++x) {
+               row[x - left] =
+                   it == blocks.end()
+                       ? 0
+                       : tileColors[toUT(it->second[y - blockY * blockSize]
+                                                   [x - blockX * blockSize])];
+            }
+         }
+      }
+   }
+   // Tint the cells with creatures; 16 or more creatures give the strongest tint.
+   for (std::int64_t cellY = floorDiv(top, densityCellSize);
+        cellY * densityCellSize < bottom; ++cellY) {
+      for (std::int64_t cellX = floorDiv(left, densityCellSize);
+           cellX * densityCellSize < right; ++cellX) {
+         const auto it = density.find({cellX, cellY});
+         if (it == density.end()) continue;
+         const std::uint32_t weight = 64 + 8 * std::min<std::uint32_t>(it->second, 16);
+         const std::int64_t x0 = std::max(left, cellX * densityCellSize);
+         const std::int64_t x1 = std::min(right, (cellX + 1) * densityCellSize);
+         const std::int64_t y0 = std::max(top, cellY * densityCellSize);
+         const std::int64_t y1 = std::min(bottom, (cellY + 1) * densityCellSize);
+         for (std::int64_t y = y0; y < y1; ++y) {
+            std::uint32_t* row = pixels + (y - top) * width;
+            for (std::int64_t x = x0; x < x1; ++x) {
+               row[x - left] = tint(row[x - left], weight);
+            }
+         }
+      }
+   }
+   return true;
+}
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,84 @@
+#ifndef MINIMAP_HPP_R8KD4XWN
+#define MINIMAP_HPP_R8KD4XWN
+
+#include <atomic>              // atomic
+#include <condition_variable>  // condition_variable
+#include <cstddef>             // size_t
+#include <cstdint>             // int64_t, uint16_t, uint32_t, uint64_t
+#include <mutex>               // mutex
+#include <thread>              // thread
+#include <unordered_map>       // unordered_map
+#include <vector>              // vector
+
+#include "map_generator.hpp"
+#include "world.hpp"
+
+// A map of a large area at one pixel per tile with the density of creatures overlaid.  A
+// background thread generates the terrain block by block, starting with the blocks
+// closest to the center, and counts creatures.  It only holds the lock on the data while
+// storing a finished block or count, and painting doesn't wait for the lock at all, so
+// neither painting nor stepping the simulation waits for the minimap.
+class Minimap {
+  public:
+   using Pos = World::Pos;
+
+   // Blocks are generated up to this many blocks away from the center block in either
+   // direction.
+   static constexpr std::int64_t radius = 32;
+   // Creatures are counted in squares of this many tiles.
+   static constexpr std::int64_t densityCellSize = 8;
+
+   // Generate terrain the way `mapGen` does.
+   explicit Minimap(const MapGenerator& mapGen);
+   ~Minimap();
+
+   Minimap(const Minimap&) = delete;
+   Minimap& operator=(const Minimap&) = delete;
+
+   // Generate the blocks around the tile (x, y) next.  Blocks that are far away from it
+   // are forgotten.
+   void setCenter(std::int64_t x, std::int64_t y);
+
+   // Replace the creatures whose density is shown.
+   void setCreatures(std::vector<Pos> positions);
+
+   // Write the area of `width` x `height` tiles with the top-left tile (left, top) to
+   // `pixels`, row by row, as 0xRRGGBB.  Tiles that weren't generated yet are black.
+   // Returns false without writing anything if the background thread is storing data;
+   // try again later.
+   bool tryPaint(std::int64_t left, std::int64_t top, int width, int height,
+                 std::uint32_t* pixels) const;
+
+   // Changes whenever a block or the creature density was updated.
+   std::uint64_t getVersion() const { return version; }
+
+  private:
+   using PosHash = World::PosHash;
+
+   void work();
+
+   const MapGenerator mapGen;
+   // The offsets of all blocks within `radius` of the center block, closest first.
+   std::vector<Pos> offsets;
+
+   mutable std::mutex mutex;
+   // Everything below is guarded by `mutex`.
+   std::condition_variable wake;
+   bool stopping = false;
+   bool hasCenter = false;
+   Pos centerBlock{{0, 0}};
+   std::size_t nextOffset;  // Into `offsets`; all blocks are done when it's the size.
+   std::unordered_map<Pos, MapGenerator::TerrainBlock, PosHash> blocks;  // By (x, y).
+   std::vector<Pos> pendingCreatures;
+   bool creaturesChanged = false;
+   // The number of creatures in each density cell that has any.
+   std::unordered_map<Pos, std::uint16_t, PosHash> density;
+
+   std::atomic<std::uint64_t> version{0};
+   // Declared last, so it starts after everything it uses is initialized.
+   std::thread worker;
+};
+
+#endif  // MINIMAP_HPP_R8KD4XWN
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,227 @@
+#ifndef PATH_CACHE_HPP_K2V8TQNE
+#define PATH_CACHE_HPP_K2V8TQNE
+
+#include <algorithm>      // std::find
+#include <cstddef>        // size_t
+#include <functional>     // equal_to
+#include <istream>        // istream
+#include <iterator>       // prev
+#include <list>           // list
+#include <memory>         // shared_ptr
+#include <ostream>        // ostream
+#include <stdexcept>      // runtime_error
+#include <unordered_map>  // unordered_map, unordered_multimap
+#include <utility>        // pair
+#include <vector>         // vector
+
+#include "pool_allocator.hpp"
+
+// Remembers recently planned paths, so searches don't have to be repeated.  An animal
+// asks for the path to its destination on every step while it moves along it, each time
+// starting further down the path, and animals of a herd often head for the same tile.  A
+// cached path therefore serves every query that starts anywhere on it and has the same
+// destination.  Holds at most `capacity` paths with at most `maxBytes` of positions in
+// all and forgets the least recently used ones first.  Short paths and the nodes of its
+// containers come from a `NodePool`, and a full cache recycles the memory of the path it
+// forgets, so inserting rarely calls `operator new`.  Not thread-safe.
+//
+// Which paths are cached decides which paths are found, so `World` saves the cache with
+// its state.  The budget counts positions rather than allocated bytes, because those
+// depend on which memory happened to be recycled.
+//
+// The cache knows nothing about the terrain.  Instead of tagging paths with the epoch of
+// the terrain cache they were planned on, `World` clears it whenever the terrain cache
+// moves, which forgets the same paths and frees their memory right away.
+//
+// Paths are stored the way `World::getPath` returns them: the destination first and the
+// start last.
+template <typename Pos, typename Hash>
+class PathCache {
+  public:
+   PathCache(std::size_t capacity, std::size_t maxBytes, std::shared_ptr<NodePool> pool)
+       : routes{PoolAllocator<Route>{pool, &bytes}},
+         byDest{0, Hash{}, std::equal_to<Pos>{}, PoolAllocator<IndexEntry>{pool, &bytes}},
+         capacity{capacity},
+         maxBytes{maxBytes} {}
+   // The allocators point to `bytes`.
+   PathCache(const PathCache&) = delete;
+   PathCache& operator=(const PathCache&) = delete;
+
+   // If a cached path to `dest` passes `start`, write the part from `start` on to `path`
+   // and return true.
+   bool find(const Pos& start, const Pos& dest, std::vector<Pos>& path);
+
+   // Remember a path from `path.back()` to `path.front()`.
+   void insert(const std::vector<Pos>& path);
+
+   void clear();
+   std::size_t size() const { return routes.size(); }
+   std::size_t getCapacity() const { return capacity; }
+   void setCapacity(std::size_t);
+   std::size_t getMaxBytes() const { return maxBytes; }
+   void setMaxBytes(std::size_t);
+
+   // The memory of the paths and of the nodes and buckets of the containers.
+   std::size_t bytesUsed() const { return bytes; }
+
+   // Write the paths as text, such that `read` restores the order in which they are
+   // found and forgotten.
+   void write(std::ostream&) const;
+   // Replace the paths with ones written by `write`.  Throws `std::runtime_error` if
+   // they can't be parsed.
+   void read(std::istream&);
+
+  private:
+   using Route = std::vector<Pos, PoolAllocator<Pos>>;
+   using RouteList = std::list<Route, PoolAllocator<Route>>;
+   using RouteIt = typename RouteList::iterator;
+   using IndexEntry = std::pair<const Pos, RouteIt>;
+
+   void evict();
+   // Forget the least recently used paths while over the capacity or the memory budget.
+   // Keeps the most recent path, however long it is.
+   void shrink();
+
+   std::size_t bytes = 0;  // Declared before the containers counting into it.
+   std::size_t numPositions = 0;  // In all routes.
+   RouteList routes;  // The most recently used first.
+   std::unordered_multimap<Pos, RouteIt, Hash, std::equal_to<Pos>,
+                           PoolAllocator<IndexEntry>>
+       byDest;
+   std::size_t capacity;
+   std::size_t maxBytes;
+};
+
+template <typename Pos, typename Hash>
+bool PathCache<Pos, Hash>::find(const Pos& start, const Pos& dest,
+                                std::vector<Pos>& path) {
+   auto range = byDest.equal_range(dest);
+   for (auto it = range.first; it != range.second; ++it) {
+      const Route& route = *it->second;
+      auto startIt = std::find(route.begin(), route.end(), start);
+      if (startIt != route.end()) {
+         path.assign(route.begin(), startIt + 1);
+         routes.splice(routes.begin(), routes, it->second);
+         return true;
+      }
+   }
+   return false;
+}
+
+template <typename Pos, typename Hash>
+void PathCache<Pos, Hash>::insert(const std::vector<Pos>& path) {
+   if (capacity == 0 || path.empty()) return;
+   if (routes.size() < capacity) {
+      routes.emplace_front(path.begin(), path.end(), routes.get_allocator());
+   } else {
+      // Recycle the least recently used route, so a full cache doesn't allocate.
+      evict();
+      routes.splice(routes.begin(), routes, std::prev(routes.end()));
+      routes.front().assign(path.begin(), path.end());
+   }
+   numPositions += path.size();
+   byDest.emplace(path.front(), routes.begin());
+   shrink();
+}
+
+template <typename Pos, typename Hash>
+void PathCache<Pos, Hash>::clear() {
+   routes.clear();
+   byDest.clear();
+   numPositions = 0;
+}
+
+template <typename Pos, typename Hash>
+void PathCache<Pos, Hash>::setCapacity(std::size_t capacity) {
+   this->capacity = capacity;
+   shrink();
+}
+
+template <typename Pos, typename Hash>
+void PathCache<Pos, Hash>::setMaxBytes(std::size_t maxBytes) {
+   this->maxBytes = maxBytes;
+   shrink();
+}
+
+template <typename Pos, typename Hash>
+void PathCache<Pos, Hash>::shrink() {
+   while (routes.size() > capacity ||
+          (numPositions * sizeof(Pos) > maxBytes && routes.size() > 1)) {
+      evict();
+      routes.pop_back();
+   }
+}
+
+// The routes, the most recently used first, and then the index of the route of each
+// entry of `byDest` in its order: of the routes to one destination, `find` tries the
+// first one in `byDest` first.
+template <typename Pos, typename Hash>
+void PathCache<Pos, Hash>::write(std::ostream& oStream) const {
+   std::unordered_map<const Route*, std::size_t> indices;
+   oStream << routes.size() << ' ' << byDest.bucket_count() << '\n';
+   for (const Route& route : routes) {
+      indices.emplace(&route, indices.size());
+      oStream << route.size();
+      for (const Pos& pos : route) {
+         for (auto coordinate : pos) oStream << ' ' << coordinate;
+      }
+      oStream << '\n';
+   }
+   for (const auto& entry : byDest) oStream << indices[&*entry.second] << ' ';
+   oStream << '\n';
+}
+
+template <typename Pos, typename Hash>
+void PathCache<Pos, Hash>::read(std::istream& iStream) {
+   const std::runtime_error invalid{"invalid path cache"};
+   clear();
+   std::size_t numRoutes, bucketCount;
+   iStream >> numRoutes >> bucketCount;
+   if (!iStream) throw invalid;
+   byDest.rehash(bucketCount);
+   std::vector<RouteIt> routeIts;
+   routeIts.reserve(numRoutes);
+   for (std::size_t n = 0; n < numRoutes; ++n) {
+      std::size_t size;
+      iStream >> size;
+      if (!iStream || size == 0) throw invalid;
+      routes.emplace_back(size, Pos{}, routes.get_allocator());
+      for (Pos& pos : routes.back()) {
+         for (auto& coordinate : pos) iStream >> coordinate;
+      }
+      numPositions += size;
+      routeIts.push_back(std::prev(routes.end()));
+   }
+   std::vector<RouteIt> order(numRoutes);
+   for (RouteIt& it : order) {
+      std::size_t index;
+      iStream >> index;
+      if (!iStream || index >= numRoutes) throw invalid;
+      it = routeIts[index];
+   }
+   // With the bucket count of the writer, `emplace` puts an entry before the others with
+   // the same key or in the same bucket, or, for an empty bucket, at the front (in
+   // libstdc++), so inserting the entries backwards restores the writer's order.
+   for (auto it = order.rbegin(); it != order.rend(); ++it) {
+      byDest.emplace((*it)->front(), *it);
+   }
+   shrink();
+}
+
+// Remove the least recently used route from the index; the caller removes or reuses it.
+template <typename Pos, typename Hash>
+void PathCache<Pos, Hash>::evict() {
+   const RouteIt last = std::prev(routes.end());
+   numPositions -= last->size();
+   auto range = byDest.equal_range(last->front());
+   for (auto it = range.first; it != range.second; ++it) {
+      if (it->second == last) {
+         byDest.erase(it);
+         return;
+      }
+   }
+}
+
+#endif  // PATH_CACHE_HPP_K2V8TQNE
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,343 @@
+#include "path_hierarchy.hpp"
+
+#include <algorithm>   // std::min, std::push_heap, std::pop_heap, std::reverse
+#include <cassert>     // assert
+#include <climits>     // CHAR_BIT
+#include <cstdlib>     // abs
+#include <functional>  // greater
+
+namespace {
+using Entry = std::pair<unsigned, int>;
+
+// `frontier` is a binary heap with the smallest priority at the front.
+void push(std::vector<Entry>& frontier, unsigned priority, int index) {
+   frontier.emplace_back(priority, index);
+   std::push_heap(frontier.begin(), frontier.end(), std::greater<Entry>{});
+}
+
+Entry pop(std::vector<Entry>& frontier) {
+   std::pop_heap(frontier.begin(), frontier.end(), std::greater<Entry>{});
+   Entry top = frontier.back();
+   frontier.pop_back();
+   return top;
+}
+
+template <typename T>
+std::size_t bytesOf(const std::vector<T>& v) {
+   return v.capacity() * sizeof(T);
+}
+
+std::size_t bytesOf(const std::vector<bool>& v) { return v.capacity() / CHAR_BIT; }
+
+template <typename T>
+std::size_t bytesOf(const std::vector<std::vector<T>>& v) {
+   std::size_t bytes = v.capacity() * sizeof(std::vector<T>);
+   for (const auto& inner : v) bytes += bytesOf(inner);
+   return bytes;
+}
+}
+
+// Definitions of members that are bound to references (e.g. by `std::min`).
+constexpr int PathHierarchy::clusterSize;
+constexpr unsigned PathHierarchy::unreached;
+
+std::size_t PathHierarchy::bytesUsed() const {
+   std::size_t bytes = bytesOf(frontier) + bytesOf(nodeCost) + bytesOf(nodePrevious) +
+                       bytesOf(nodeClosed) + bytesOf(startEdges) + bytesOf(destCost) +
+                       bytesOf(nodeSequence) + bytesOf(forwardPath);
+   for (const Layer& layer : layers) {
+      bytes += bytesOf(layer.costs) + bytesOf(layer.nodeCells) + bytesOf(layer.edges) +
+               bytesOf(layer.clusterNodes) + bytesOf(layer.nodeAt);
+   }
+   return bytes;
+}
+
+int PathHierarchy::getCluster(int cell) const {
+   const Cell c = toCell(cell);
+   return (c[1] / clusterSize) * clustersX + c[0] / clusterSize;
+}
+
+int PathHierarchy::toLocal(int cell) const {
+   const Cell c = toCell(cell);
+   return (c[1] % clusterSize) * clusterSize + c[0] % clusterSize;
+}
+
+void PathHierarchy::build(Layer& layer, Work& work) {
+   layer.nodeCells.clear();
+   layer.edges.clear();
+   layer.clusterNodes.assign(clustersX * clustersY, {});
+   layer.nodeAt.assign(layer.costs.size(), -1);
+
+   // Entrances on the borders between horizontally adjacent clusters.
+   for (int cy = 0; cy < clustersY; ++cy) {
+      const int top = cy * clusterSize;
+      const int length = std::min(clusterSize, height - top);
+      for (int x = clusterSize; x < width; x += clusterSize) {
+         addEntrances(layer, top * width + x - 1, top * width + x, width, length);
+      }
+   }
+   // Entrances on the borders between vertically adjacent clusters.
+   for (int y = clusterSize; y < height; y += clusterSize) {
+      for (int cx = 0; cx < clustersX; ++cx) {
+         const int left = cx * clusterSize;
+         const int length = std::min(clusterSize, width - left);
+         addEntrances(layer, (y - 1) * width + left, y * width + left, 1, length);
+      }
+   }
+
+   // Connect the nodes of each cluster.  Building doesn't count as expanding nodes.
+   Work buildWork;
+   for (int cluster = 0; cluster < clustersX * clustersY; ++cluster) {
+      const auto& nodes = layer.clusterNodes[cluster];
+      for (int from : nodes) {
+         searchCluster(layer, cluster, layer.nodeCells[from], -1, false, buildWork);
+         for (int to : nodes) {
+            const unsigned cost = localCost[toLocal(layer.nodeCells[to])];
+            if (to != from && cost != unreached) {
+               layer.edges[from].push_back(Edge{to, cost});
+            }
+         }
+      }
+      ++work.clusters;
+   }
+   layer.isBuilt = true;
+}
+
+int PathHierarchy::addNode(Layer& layer, int cell) {
+   int& node = layer.nodeAt[cell];
+   if (node < 0) {
+      node = static_cast<int>(layer.nodeCells.size());
+      layer.nodeCells.push_back(cell);
+      layer.edges.emplace_back();
+      layer.clusterNodes[getCluster(cell)].push_back(node);
+   }
+   return node;
+}
+
+// Cells `firstA + i * step` and `firstB + i * step` for i in [0, length) face each other
+// across a border.  Every run of pairs that are both passable is an entrance.  Short runs
+// get a pair of nodes in the middle, long ones a pair at either end.
+void PathHierarchy::addEntrances(Layer& layer, int firstA, int firstB, int step,
+                                 int length) {
+   constexpr int maxShortRun = 5;
+   auto connect = [&](int i) {
+      const int cellA = firstA + i * step, cellB = firstB + i * step;
+      const int a = addNode(layer, cellA);
+      const int b = addNode(layer, cellB);
+      layer.edges[a].push_back(Edge{b, static_cast<unsigned>(layer.costs[cellB])});
+      layer.edges[b].push_back(Edge{a, static_cast<unsigned>(layer.costs[cellA])});
+   };
+   int runStart = -1;
+   for (int i = 0; i <= length; ++i) {
+      const bool isOpen = i < length && layer.costs[firstA + i * step] >= 0 &&
+                          layer.costs[firstB + i * step] >= 0;
+      if (isOpen && runStart < 0) {
+         runStart = i;
+      } else if (!isOpen && runStart >= 0) {
+         if (i - runStart <= maxShortRun) {
+            connect(runStart + (i - runStart) / 2);
+         } else {
+            connect(runStart);
+            connect(i - 1);
+         }
+         runStart = -1;
+      }
+   }
+}
+
+void PathHierarchy::searchCluster(const Layer& layer, int cluster, int source,
+                                  int target, bool reverse, Work& work) {
+   const int left = cluster % clustersX * clusterSize;
+   const int top = cluster / clustersX * clusterSize;
+   const int right = std::min(left + clusterSize, width);
+   const int bottom = std::min(top + clusterSize, height);
+   // With a target, this is A*.  Every step costs at least 1, so the Manhattan distance
+   // is a consistent heuristic.
+   const int targetX = target % width, targetY = target / width;
+   auto getHeuristic = [&](int cell) {
+      if (target < 0) return 0u;
+      return static_cast<unsigned>(std::abs(cell % width - targetX) +
+                                   std::abs(cell / width - targetY));
+   };
+   localCost.fill(unreached);
+   localCost[toLocal(source)] = 0;
+   localPrevious[toLocal(source)] = -1;
+   frontier.clear();
+   push(frontier, getHeuristic(source), source);
+   while (!frontier.empty()) {
+      const Entry entry = pop(frontier);
+      const int cell = entry.second;
+      const unsigned cellCost = localCost[toLocal(cell)];
+      if (entry.first > cellCost + getHeuristic(cell)) continue;  // Outdated.
+      ++work.nodes;
+      if (cell == target) break;
+      const int x = cell % width, y = cell / width;
+      const int neighbors[] = {x > left ? cell - 1 : -1, x + 1 < right ? cell + 1 : -1,
+                               y > top ? cell - width : -1,
+                               y + 1 < bottom ? cell + width : -1};
+      for (int next : neighbors) {
+         if (next < 0 || layer.costs[next] < 0) continue;
+         // Going backwards, `next` is where we come from and `cell` is entered.
+         const unsigned cost =
+             cellCost + static_cast<unsigned>(layer.costs[reverse ? cell : next]);
+         unsigned& nextCost = localCost[toLocal(next)];
+         if (cost < nextCost) {
+            nextCost = cost;
+            localPrevious[toLocal(next)] = cell;
+            push(frontier, cost + getHeuristic(next), next);
+         }
+      }
+   }
+}
+
+void PathHierarchy::appendLocalPath(int from, int to) {
+   assert(localCost[toLocal(to)] != unreached);
+   const auto first = forwardPath.size();
+   for (int cell = to; cell != from; cell = localPrevious[toLocal(cell)]) {
+      forwardPath.push_back(cell);
+   }
+   std::reverse(forwardPath.begin() + first, forwardPath.end());
+}
+
+void PathHierarchy::refine(const Layer& layer, int cluster, int from, int to,
+                           Work& work) {
+   if (from == to) return;
+   searchCluster(layer, cluster, from, to, false, work);
+   appendLocalPath(from, to);
+}
+
+void PathHierarchy::writePath(std::vector<Cell>& path) const {
+   path.clear();
+   path.reserve(forwardPath.size());
+   for (auto it = forwardPath.rbegin(); it != forwardPath.rend(); ++it) {
+      path.push_back(toCell(*it));
+   }
+}
+
+PathHierarchy::Work PathHierarchy::findPath(Cell start, Cell dest, bool onLand,
+                                            std::vector<Cell>& path) {
+   assert(0 <= start[0] && start[0] < width && 0 <= start[1] && start[1] < height);
+   assert(0 <= dest[0] && dest[0] < width && 0 <= dest[1] && dest[1] < height);
+   Work work;
+   Layer& layer = layers[onLand];
+   if (!layer.isBuilt) build(layer, work);
+
+   const int startCell = start[1] * width + start[0];
+   const int destCell = dest[1] * width + dest[0];
+   const int startCluster = getCluster(startCell);
+   const int destCluster = getCluster(destCell);
+   auto distanceToDest = [&](int cell) {
+      const Cell c = toCell(cell);
+      return static_cast<unsigned>(std::abs(c[0] - dest[0]) + std::abs(c[1] - dest[1]));
+   };
+   forwardPath.clear();
+   forwardPath.push_back(startCell);
+
+   // Search the start's cluster.  That's all we need if the destination is in it, and
+   // it connects the start to the abstract graph otherwise.
+   searchCluster(layer, startCluster, startCell, -1, false, work);
+   if (startCluster == destCluster && localCost[toLocal(destCell)] != unreached) {
+      appendLocalPath(startCell, destCell);
+      writePath(path);
+      return work;
+   }
+   startEdges.clear();
+   for (int node : layer.clusterNodes[startCluster]) {
+      const unsigned cost = localCost[toLocal(layer.nodeCells[node])];
+      if (cost != unreached) startEdges.push_back(Edge{node, cost});
+   }
+   // Where to go if the destination can't be reached.
+   int closestCell = startCell;
+   {
+      const int left = startCluster % clustersX * clusterSize;
+      const int top = startCluster / clustersX * clusterSize;
+      const int right = std::min(left + clusterSize, width);
+      const int bottom = std::min(top + clusterSize, height);
+      for (int y = top; y < bottom; ++y) {
+         for (int cell = y * width + left; cell < y * width + right; ++cell) {
+            if (localCost[toLocal(cell)] != unreached &&
+                distanceToDest(cell) < distanceToDest(closestCell)) {
+               closestCell = cell;
+            }
+         }
+      }
+   }
+
+   // Connect the destination by searching its cluster backwards.
+   const int numNodes = static_cast<int>(layer.nodeCells.size());
+   destCost.assign(numNodes, unreached);
+   searchCluster(layer, destCluster, destCell, -1, true, work);
+   for (int node : layer.clusterNodes[destCluster]) {
+      destCost[node] = localCost[toLocal(layer.nodeCells[node])];
+   }
+
+   // A* on the abstract graph.  The start and the destination are two extra nodes.
+   const int startNode = numNodes, destNode = numNodes + 1;
+   auto getCell = [&](int node) {
+      return node == startNode ? startCell
+                               : node == destNode ? destCell : layer.nodeCells[node];
+   };
+   nodeCost.assign(numNodes + 2, unreached);
+   nodePrevious.assign(numNodes + 2, -1);
+   nodeClosed.assign(numNodes + 2, false);
+   nodeCost[startNode] = 0;
+   frontier.clear();
+   push(frontier, distanceToDest(startCell), startNode);
+   int closestNode = startNode;
+   while (!frontier.empty()) {
+      const int node = pop(frontier).second;
+      if (nodeClosed[node]) continue;
+      nodeClosed[node] = true;
+      ++work.nodes;
+      if (node == destNode) break;
+      if (distanceToDest(getCell(node)) < distanceToDest(getCell(closestNode))) {
+         closestNode = node;
+      }
+      auto relax = [&](int next, unsigned edgeCost) {
+         const unsigned cost = nodeCost[node] + edgeCost;
+         if (cost < nodeCost[next]) {
+            nodeCost[next] = cost;
+            nodePrevious[next] = node;
+            push(frontier, cost + distanceToDest(getCell(next)), next);
+         }
+      };
+      if (node == startNode) {
+         for (const Edge& edge : startEdges) relax(edge.to, edge.cost);
+      } else {
+         for (const Edge& edge : layer.edges[node]) relax(edge.to, edge.cost);
+         if (destCost[node] != unreached) relax(destNode, destCost[node]);
+      }
+   }
+
+   int last = destNode;
+   if (!nodeClosed[destNode]) {
+      // Unreachable.  Head for whatever got closest.
+      if (distanceToDest(closestCell) <= distanceToDest(getCell(closestNode))) {
+         refine(layer, startCluster, startCell, closestCell, work);
+         writePath(path);
+         return work;
+      }
+      last = closestNode;
+   }
+
+   // Refine the abstract path.  Consecutive nodes in the same cluster are connected by a
+   // path inside it; the others are the two sides of an entrance.
+   nodeSequence.clear();
+   for (int node = last; node != -1; node = nodePrevious[node]) {
+      nodeSequence.push_back(node);
+   }
+   assert(nodeSequence.back() == startNode);
+   for (auto it = nodeSequence.rbegin(); it + 1 != nodeSequence.rend(); ++it) {
+      const int from = getCell(it[0]), to = getCell(it[1]);
+      const int cluster = getCluster(from);
+      if (cluster == getCluster(to)) {
+         refine(layer, cluster, from, to, work);
+      } else {
+         forwardPath.push_back(to);
+      }
+   }
+   writePath(path);
+   return work;
+}
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,125 @@
+#ifndef PATH_HIERARCHY_HPP_3WXN7TQE
+#define PATH_HIERARCHY_HPP_3WXN7TQE
+
+#include <array>    // array
+#include <cstddef>  // size_t
+#include <cstdint>  // int8_t, uint32_t
+#include <utility>  // pair
+#include <vector>   // vector
+
+// Hierarchical path-finding A* (HPA*, Botea, Müller, and Schaeffer, 2004) on a grid of
+// movement costs.  The grid is split into square clusters.  Where passable tiles line up
+// along the border of two clusters, there's an entrance: a pair of nodes, one on either
+// side.  The nodes of a cluster are connected by the costs of the shortest paths between
+// them inside the cluster.  A long search then only has to explore this abstract graph
+// and the clusters of the start and destination, and refines the result by short
+// searches inside single clusters.  Paths are near-optimal rather than optimal.
+//
+// There's a separate graph for land and for water animals.  Graphs are built by the first
+// search that needs them after the terrain changed.  Not thread-safe.
+class PathHierarchy {
+  public:
+   static constexpr int clusterSize = 16;
+
+   // Grid coordinates; (0, 0) is the top-left tile.
+   using Cell = std::array<int, 2>;
+
+   // What a search did; for the `StepStats`.
+   struct Work {
+      std::uint32_t nodes = 0;     // Tiles and abstract nodes expanded.
+      std::uint32_t clusters = 0;  // Clusters whose nodes were connected.
+   };
+
+   // Replace the terrain.  `getCost(x, y, onLand)` is the cost of entering the tile at
+   // (x, y) or a negative number if the tile can't be entered.
+   template <typename CostFunction>
+   void setTerrain(int width, int height, CostFunction getCost);
+
+   // Find a path from `start` to `dest` for a land or water animal and write it to `path`
+   // in reverse, i.e. beginning with the destination and ending with `start`.  If `dest`
+   // can't be reached, the path leads to the entrance or tile of the start's cluster that
+   // is closest to it.
+   Work findPath(Cell start, Cell dest, bool onLand, std::vector<Cell>& path);
+
+   // The memory held by the graphs and the scratch space of searches.
+   std::size_t bytesUsed() const;
+
+  private:
+   struct Edge {
+      int to;  // Node index.
+      unsigned cost;
+   };
+
+   struct Layer {
+      std::vector<std::int8_t> costs;  // Row by row; negative for impassable tiles.
+      bool isBuilt = false;
+      std::vector<int> nodeCells;               // The cell index of each node.
+      std::vector<std::vector<Edge>> edges;     // Outgoing edges of each node.
+      std::vector<std::vector<int>> clusterNodes;
+      std::vector<int> nodeAt;  // The node at a cell index, or -1.
+   };
+
+   int getCluster(int cell) const;
+   Cell toCell(int cell) const { return Cell{cell % width, cell / width}; }
+
+   void build(Layer&, Work&);
+   int addNode(Layer&, int cell);
+   void addEntrances(Layer&, int firstA, int firstB, int step, int length);
+
+   // Dijkstra's algorithm on the tiles of `cluster`, starting at `source`.  If `target`
+   // isn't -1, it's A* instead and stops once `target` is settled.  A reverse search
+   // computes the costs of the paths leading to `source` instead of away from it.
+   // Results are in `localCost` and `localPrevious`, indexed by `toLocal`.
+   void searchCluster(const Layer&, int cluster, int source, int target, bool reverse,
+                      Work&);
+   int toLocal(int cell) const;
+   // Append the tiles after `from` up to and including `to` (both in `cluster`) to
+   // `forwardPath`.
+   void refine(const Layer&, int cluster, int from, int to, Work&);
+   // Like `refine`, but uses the results of the last `searchCluster` from `from`.
+   void appendLocalPath(int from, int to);
+   // Write `forwardPath` to `path` in reverse.
+   void writePath(std::vector<Cell>& path) const;
+
+   int width = 0;
+   int height = 0;
+   int clustersX = 0;
+   int clustersY = 0;
+   std::array<Layer, 2> layers;  // Water, land.
+
+   // Scratch space of the searches.
+   static constexpr unsigned unreached = ~0u;
+   std::array<unsigned, clusterSize * clusterSize> localCost;
+   std::array<int, clusterSize * clusterSize> localPrevious;  // Cell indices.
+   std::vector<std::pair<unsigned, int>> frontier;  // Priorities and cell/node indices.
+   std::vector<unsigned> nodeCost;
+   std::vector<int> nodePrevious;
+   std::vector<bool> nodeClosed;
+   std::vector<Edge> startEdges;
+   std::vector<unsigned> destCost;  // Per node; `unreached` outside the dest's cluster.
+   std::vector<int> nodeSequence;   // The abstract path, from the destination.
+   std::vector<int> forwardPath;    // Cell indices from start to destination.
+};
+
+template <typename CostFunction>
+void PathHierarchy::setTerrain(int width, int height, CostFunction getCost) {
+   this->width = width;
+   this->height = height;
+   clustersX = (width + clusterSize - 1) / clusterSize;
+   clustersY = (height + clusterSize - 1) / clusterSize;
+   for (bool onLand : {false, true}) {
+      Layer& layer = layers[onLand];
+      layer.costs.resize(static_cast<std::size_t>(width) * height);
+      for (int y = 0; y < height; ++y) {
+         for (int x = 0; x < width; ++x) {
+            const int cost = getCost(x, y, onLand);
+            layer.costs[y * width + x] = static_cast<std::int8_t>(cost < 0 ? -1 : cost);
+         }
+      }
+      layer.isBuilt = false;
+   }
+}
+
+#endif  // PATH_HIERARCHY_HPP_3WXN7TQE
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,86 @@
+#include "pool_allocator.hpp"
+
+#include <cassert>  // assert
+
+void* NodePool::allocate(std::size_t size) {
+   assert(0 < size && size <= maxNodeSize);
+   const std::size_t sizeClass = (size - 1) / granularity;
+   if (!freeLists[sizeClass]) refill(sizeClass);
+   FreeNode* node = freeLists[sizeClass];
+   freeLists[sizeClass] = node->next;
+   inUse += nodeSize(size);
+   return node;
+}
+
+void NodePool::deallocate(void* node, std::size_t size) {
+   assert(0 < size && size <= maxNodeSize);
+   const std::size_t sizeClass = (size - 1) / granularity;
+   auto freeNode = static_cast<FreeNode*>(node);
+   freeNode->next = freeLists[sizeClass];
+   freeLists[sizeClass] = freeNode;
+   inUse -= nodeSize(size);
+}
+
+std::size_t NodePool::bytesReserved() const { return chunks.size() * chunkSize; }
+
+// Carve a new chunk into nodes of the given size class and put them on its free list.
+void NodePool::refill(std::size_t sizeClass) {
+   const std::size_t nodeSize = (sizeClass + 1) * granularity;
+   // `new char[]` returns memory suitably aligned for any object of fundamental alignment
+   // that fits.
+   chunks.emplace_back(new char[chunkSize]);
+   char* chunk = chunks.back().get();
+   for (std::size_t offset = 0; offset + nodeSize <= chunkSize; offset += nodeSize) {
+      auto freeNode = reinterpret_cast<FreeNode*>(chunk + offset);
+      freeNode->next = freeLists[sizeClass];
+      freeLists[sizeClass] = freeNode;
+   }
+}
+
+void* Arena::allocate(std::size_t size, std::size_t alignment) {
+   while (true) {
+      if (current < chunks.size()) {
+         Chunk& chunk = chunks[current];
+         std::size_t begin = (offset + alignment - 1) / alignment * alignment;
+         if (begin + size <= chunk.size) {
+            offset = begin + size;
+            return chunk.data.get() + begin;
+         }
+         // Try the next chunk; this one can't fit the allocation.
+         if (current + 1 < chunks.size()) {
+            ++current;
+            offset = 0;
+            continue;
+         }
+      }
+      // Add a chunk big enough for the allocation.  The chunks before it stay unused
+      // until the arena is rewound.
+      std::size_t newSize = size + alignment > chunkSize ? size + alignment : chunkSize;
+      chunks.push_back(Chunk{std::unique_ptr<char[]>{new char[newSize]}, newSize});
+      current = chunks.size() - 1;
+      offset = 0;
+   }
+}
+
+void Arena::rewind(Arena::Mark mark) {
+   assert(mark.chunk < current || (mark.chunk == current && mark.offset <= offset) ||
+          chunks.empty());
+   current = mark.chunk;
+   offset = mark.offset;
+}
+
+void Arena::release() {
+   assert(current == 0 && offset == 0);
+   chunks.clear();
+   chunks.shrink_to_fit();
+}
+
+std::size_t Arena::bytesReserved() const {
+   std::size_t bytes = 0;
+   for (const auto& chunk : chunks) {
+      bytes += chunk.size;
+   }
+   return bytes;
+}
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,202 @@
+#ifndef POOL_ALLOCATOR_HPP_V5EK0RQA
+#define POOL_ALLOCATOR_HPP_V5EK0RQA
+
+#include <cstddef>  // size_t, max_align_t
+#include <memory>   // shared_ptr, unique_ptr
+#include <new>      // operator new, operator delete
+#include <vector>   // vector
+
+// Hands out memory for single nodes of node-based containers (e.g. the nodes of an
+// `std::unordered_map`) and other small blocks from free lists.  Freed nodes are kept for
+// reuse and only returned when the pool is destroyed, so erasing an element and inserting
+// another one never calls `operator new`.  Not thread-safe.
+class NodePool {
+  public:
+   // Nodes up to this size are pooled; anything bigger is passed to `operator new`.
+   static constexpr std::size_t maxNodeSize = 256;
+
+   NodePool() = default;
+   NodePool(const NodePool&) = delete;
+   NodePool& operator=(const NodePool&) = delete;
+
+   void* allocate(std::size_t size);
+   void deallocate(void* node, std::size_t size);
+
+   // The memory allocated from the system, including nodes that are currently unused.
+   std::size_t bytesReserved() const;
+   // The memory of the nodes that are currently allocated.
+   std::size_t bytesInUse() const { return inUse; }
+
+   // The size of the node handed out for `size` bytes.
+   static std::size_t nodeSize(std::size_t size) {
+      return (size + granularity - 1) / granularity * granularity;
+   }
+
+  private:
+   static constexpr std::size_t granularity = alignof(std::max_align_t);
+   static constexpr std::size_t numClasses = maxNodeSize / granularity;
+   static constexpr std::size_t chunkSize = 64 * 1024;
+
+   struct FreeNode {
+      FreeNode* next;
+   };
+
+   void refill(std::size_t sizeClass);
+
+   FreeNode* freeLists[numClasses] = {};
+   std::vector<std::unique_ptr<char[]>> chunks;
+   std::size_t inUse = 0;
+};
+
+// An allocator for standard containers that takes single objects and small arrays (e.g.
+// short vectors) from a shared `NodePool`.  Larger arrays (e.g. the buckets of a big hash
+// map) are allocated as usual.  If given a counter, it keeps the number of bytes
+// allocated through it and its copies there, counting pooled nodes at their full size;
+// for a container, that's its nodes and, e.g., its buckets.
+template <typename T>
+class PoolAllocator {
+  public:
+   using value_type = T;
+
+   explicit PoolAllocator(std::shared_ptr<NodePool> pool,
+                          std::size_t* bytesUsed = nullptr)
+       : pool{std::move(pool)}, bytesUsed{bytesUsed} {}
+   template <typename U>
+   PoolAllocator(const PoolAllocator<U>& other)
+       : pool{other.pool}, bytesUsed{other.bytesUsed} {}
+
+   T* allocate(std::size_t n) {
+      if (isPooled(n)) {
+         count(NodePool::nodeSize(n * sizeof(T)), true);
+         return static_cast<T*>(pool->allocate(n * sizeof(T)));
+      }
+      count(n * sizeof(T), true);
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+   }
+
+   void deallocate(T* p, std::size_t n) {
+      if (isPooled(n)) {
+         count(NodePool::nodeSize(n * sizeof(T)), false);
+         pool->deallocate(p, n * sizeof(T));
+      } else {
+         count(n * sizeof(T), false);
+         ::operator delete(p);
+      }
+   }
+
+   // Memory allocated by one allocator can only be freed by another one if both count it
+   // in the same place.
+   template <typename U>
+   bool operator==(const PoolAllocator<U>& other) const {
+      return pool == other.pool && bytesUsed == other.bytesUsed;
+   }
+   template <typename U>
+   bool operator!=(const PoolAllocator<U>& other) const {
+      return !(*this == other);
+   }
+
+  private:
+   template <typename U>
+   friend class PoolAllocator;
+
+   // `NodePool` can't hand out empty blocks.
+   static bool isPooled(std::size_t n) {
+      return 0 < n && n <= NodePool::maxNodeSize / sizeof(T) &&
+             alignof(T) <= alignof(std::max_align_t);
+   }
+
+   void count(std::size_t bytes, bool allocated) {
+      if (!bytesUsed) return;
+      if (allocated) {
+         *bytesUsed += bytes;
+      } else {
+         *bytesUsed -= bytes;
+      }
+   }
+
+   std::shared_ptr<NodePool> pool;
+   std::size_t* bytesUsed;
+};
+
+// A monotonic buffer for short-lived data like the buffers of a step.
+// Deallocation does nothing; instead, everything allocated after a `Mark` is released at
+// once by `rewind`.  Chunks are kept for reuse, so a search that needs no more memory
+// than an earlier one doesn't call `operator new`.  Not thread-safe.
+class Arena {
+  public:
+   struct Mark {
+      std::size_t chunk;
+      std::size_t offset;
+   };
+
+   explicit Arena(std::size_t chunkSize = 64 * 1024) : chunkSize{chunkSize} {}
+   Arena(Arena&&) = default;
+
+   void* allocate(std::size_t size, std::size_t alignment);
+
+   Mark mark() const { return Mark{current, offset}; }
+   void rewind(Mark);
+
+   std::size_t bytesReserved() const;
+   // Free all chunks.  Nothing may be allocated, i.e. the arena was rewound to its start.
+   void release();
+
+  private:
+   struct Chunk {
+      std::unique_ptr<char[]> data;
+      std::size_t size;
+   };
+
+   const std::size_t chunkSize;
+   std::vector<Chunk> chunks;
+   std::size_t current = 0;  // Index of the chunk allocated from.
+   std::size_t offset = 0;   // Bytes used in that chunk.
+};
+
+// Rewinds an `Arena` to the state it had when the scope was entered.  Declare it before
+// the containers using the arena, so they are destroyed first.
+class ArenaScope {
+  public:
+   explicit ArenaScope(Arena& arena) : arena(arena), mark{arena.mark()} {}
+   ~ArenaScope() { arena.rewind(mark); }
+   ArenaScope(const ArenaScope&) = delete;
+   ArenaScope& operator=(const ArenaScope&) = delete;
+
+  private:
+   Arena& arena;
+   const Arena::Mark mark;
+};
+
+template <typename T>
+class ArenaAllocator {
+  public:
+   using value_type = T;
+
+   explicit ArenaAllocator(Arena& arena) : arena{&arena} {}
+   template <typename U>
+   ArenaAllocator(const ArenaAllocator<U>& other) : arena{other.arena} {}
+
+   T* allocate(std::size_t n) {
+      return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+   }
+   void deallocate(T*, std::size_t) {}
+
+   template <typename U>
+   bool operator==(const ArenaAllocator<U>& other) const {
+      return arena == other.arena;
+   }
+   template <typename U>
+   bool operator!=(const ArenaAllocator<U>& other) const {
+      return arena != other.arena;
+   }
+
+  private:
+   template <typename U>
+   friend class ArenaAllocator;
+
+   Arena* arena;
+};
+
+#endif  // POOL_ALLOCATOR_HPP_V5EK0RQA
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,59 @@
+#include "region_labels.hpp"
+
+#include <algorithm>  // max, min
+#include <climits>    // CHAR_BIT
+#include <numeric>    // iota
+
+constexpr std::uint16_t RegionLabels::unlabeled;
+
+void RegionLabels::connect() {
+   unsigned numLabels = 0;
+   for (int block = 0; block < 4; ++block) {
+      firstLabel[block] = numLabels;
+      numLabels += blocks[block].isLand.size();
+   }
+   regions.resize(numLabels);
+   std::iota(regions.begin(), regions.end(), 0u);
+   const int last = blockSize - 1;
+   for (int k = 0; k < blockSize; ++k) {
+      // Blocks side by side: the last column of the left one and the first column of the
+      // right one.
+      merge(0, blockSize * k + last, 1, blockSize * k);
+      merge(2, blockSize * k + last, 3, blockSize * k);
+      // Blocks on top of each other: the last row of the upper one and the first row of
+      // the lower one.
+      merge(0, blockSize * last + k, 2, k);
+      merge(1, blockSize * last + k, 3, k);
+   }
+   for (unsigned label = 0; label < numLabels; ++label) regions[label] = find(label);
+}
+
+std::size_t RegionLabels::bytesUsed() const {
+   std::size_t bytes = regions.capacity() * sizeof(unsigned) + media.capacity() +
+                       stack.capacity() * sizeof(int);
+   for (const Block& block : blocks) {
+      bytes += block.labels.capacity() * sizeof(std::uint16_t) +
+               block.isLand.capacity() / CHAR_BIT;
+   }
+   return bytes;
+}
+
+unsigned RegionLabels::find(unsigned label) {
+   // Path halving.
+   while (regions[label] != label) {
+      regions[label] = regions[regions[label]];
+      label = regions[label];
+   }
+   return label;
+}
+
+void RegionLabels::merge(int blockA, int cellA, int blockB, int cellB) {
+   const std::uint16_t labelA = blocks[blockA].labels[cellA];
+   const std::uint16_t labelB = blocks[blockB].labels[cellB];
+   if (blocks[blockA].isLand[labelA] != blocks[blockB].isLand[labelB]) return;
+   const unsigned rootA = find(firstLabel[blockA] + labelA);
+   const unsigned rootB = find(firstLabel[blockB] + labelB);
+   regions[std::max(rootA, rootB)] = std::min(rootA, rootB);
+}
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,109 @@
+#ifndef REGION_LABELS_HPP_H5PW3CZA
+#define REGION_LABELS_HPP_H5PW3CZA
+
+#include <array>    // array
+#include <cstddef>  // size_t
+#include <cstdint>  // uint8_t, uint16_t
+#include <vector>   // vector
+
+// The connected regions of the cached terrain: maximal sets of tiles of the same medium
+// (land or water) that an animal can move between.  Two tiles are connected if and only
+// if they have the same region, so searches can tell in constant time whether a
+// destination can be reached at all.
+//
+// The cache consists of 2x2 terrain blocks.  Each block is labeled on its own when it's
+// generated, and its labels move along with it when the cache scrolls.  Regions that
+// touch across the borders of the blocks are then merged by a union-find, which only has
+// to look at the tiles along those borders.
+class RegionLabels {
+  public:
+   explicit RegionLabels(int blockSize) : blockSize{blockSize} {}
+
+   // Label the tiles of `block` (0 to 3: top-left, top-right, bottom-left, bottom-right).
+   // `isLand(i, j)` tells the medium of the tile in row i and column j of the block.
+   template <typename IsLand>
+   void labelBlock(int block, IsLand isLand);
+
+   // Give block `dest` the labels of block `source`, whose terrain was copied to it.
+   void copyBlock(int dest, int source) { blocks[dest] = blocks[source]; }
+
+   // Merge the regions of adjacent blocks.  Has to be called after changing any block and
+   // before the next `getRegion`.
+   void connect();
+
+   // The region of the tile at (x, y), relative to the top-left tile of the cache.
+   unsigned getRegion(int x, int y) const {
+      const int block = 2 * (y / blockSize) + x / blockSize;
+      const int cell = blockSize * (y % blockSize) + x % blockSize;
+      return regions[firstLabel[block] + blocks[block].labels[cell]];
+   }
+
+   // The memory held by the labels and the scratch space.
+   std::size_t bytesUsed() const;
+
+  private:
+   struct Block {
+      std::vector<std::uint16_t> labels;  // Row by row.
+      std::vector<bool> isLand;           // Per label.
+   };
+
+   static constexpr std::uint16_t unlabeled = 0xffff;
+
+   unsigned find(unsigned label);
+   void merge(int blockA, int cellA, int blockB, int cellB);
+
+   int blockSize;
+   std::array<Block, 4> blocks;
+   // Labels of different blocks are told apart by adding the number of labels of the
+   // preceding blocks.
+   std::array<unsigned, 4> firstLabel{};
+   // Maps labels to their regions.  Parent pointers of the union-find while connecting;
+   // afterwards every label points directly to the root of its tree, which is the region.
+   std::vector<unsigned> regions;
+   // Scratch space of `labelBlock`.
+   std::vector<std::uint8_t> media;
+   std::vector<int> stack;
+};
+
+template <typename IsLand>
+void RegionLabels::labelBlock(int block, IsLand isLand) {
+   const int numCells = blockSize * blockSize;
+   media.resize(numCells);
+   for (int cell = 0; cell < numCells; ++cell) {
+      media[cell] = isLand(cell / blockSize, cell % blockSize);
+   }
+   Block& labeled = blocks[block];
+   labeled.labels.assign(numCells, unlabeled);
+   labeled.isLand.clear();
+   // Flood fill each region from its first tile.
+   for (int first = 0; first < numCells; ++first) {
+      if (labeled.labels[first] != unlabeled) continue;
+      const auto label = static_cast<std::uint16_t>(labeled.isLand.size());
+      const std::uint8_t medium = media[first];
+      labeled.isLand.push_back(medium);
+      labeled.labels[first] = label;
+      stack.assign(1, first);
+      while (!stack.empty()) {
+         const int cell = stack.back();
+         stack.pop_back();
+         const int i = cell / blockSize, j = cell % blockSize;
+         const int neighbors[][2] = {{i - 1, j}, {i + 1, j}, {i, j - 1}, {i, j + 1}};
+         for (const auto& next : neighbors) {
+            if (next[0] < 0 || next[0] >= blockSize || next[1] < 0 ||
+                next[1] >= blockSize) {
+               continue;
+            }
+            const int nextCell = blockSize * next[0] + next[1];
+            if (labeled.labels[nextCell] != unlabeled || media[nextCell] != medium) {
+               continue;
+            }
+            labeled.labels[nextCell] = label;
+            stack.push_back(nextCell);
+         }
+      }
+   }
+}
+
+#endif  // REGION_LABELS_HPP_H5PW3CZA
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -6,6 +6,16 @@
 #include <tuple>
 #include <vector>
 
+#include <boost/utility/string_view.hpp>
+
+// Parse comma-separated fields, one resource per line.  Each extractor is called with a
+// `boost::string_view` of its field and returns the corresponding tuple element or throws
+// to reject the line.  Problems are appended to `errors`; lines with errors are skipped.
+template <typename Tuple, typename Extractors>
+std::vector<Tuple> loadResources(const char* first, const char* last, Extractors,
+                                 std::vector<std::string>& errors);
+
+// Reads the whole stream into memory first.
 template <typename Tuple, typename Extractors>
 std::vector<Tuple> loadResources(std::istream&&, Extractors,
                                  std::vector<std::string>& errors);
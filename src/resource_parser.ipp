@@ -2,7 +2,11 @@
 #include <array>
 #include <boost/regex.hpp>
 #include <boost/regex/icu.hpp>
+#include <cctype>
+#include <climits>
+#include <cstring>
 #include <iostream>
+#include <iterator>
 #include <type_traits>
 #include <utility>
 
@@ -14,13 +18,13 @@ namespace {
    inline typename std::enable_if<i == sizeof...(Entries), void>::type
    loadResources(std::tuple<Entries...>&,
                  std::tuple<Extractors...>&,
-                 const std::array<std::string, sizeof...(Entries)>&) {}
+                 const std::array<boost::string_view, sizeof...(Entries)>&) {}
 
    template <std::size_t i = 0, typename... Entries, typename... Extractors>
    inline typename std::enable_if<i < sizeof...(Entries), void>::type
    loadResources(std::tuple<Entries...>& creatureType,
                  std::tuple<Extractors...>& extractors,
-                 const std::array<std::string, sizeof...(Entries)>& fields)
+                 const std::array<boost::string_view, sizeof...(Entries)>& fields)
    {
       try {
          std::get<i>(creatureType) = std::get<i>(extractors)(fields[i]);
@@ -40,30 +44,48 @@ namespace {
 
 template <typename Tuple, typename Extractors>
 std::vector<Tuple>
-loadResources(std::istream&& iStream, Extractors extractors,
+loadResources(const char* first, const char* last, Extractors extractors,
               std::vector<std::string>& errors)
 {
    constexpr auto fieldCount = std::tuple_size<Tuple>::value;
 
    std::vector<Tuple> resources;
-   std::istream::char_type nextChar;
-
-   int line   = 1;
-   int column = 1;
-
-   // Use whatever type fieldCount has but make sure it's not const (or volatile).
-   typename std::remove_cv<decltype(fieldCount)>::type fieldIndex = 0;
-
-   std::array<std::string, fieldCount> fields;
+   std::array<boost::string_view, fieldCount> fields;
+
+   int line = 1;
+   for (const char* lineBegin = first; lineBegin != last; ++line) {
+      auto lineEnd =
+         static_cast<const char*>(std::memchr(lineBegin, '\n', last - lineBegin));
+      const char* next = lineEnd ? lineEnd + 1 : last;
+      if (!lineEnd) lineEnd = last;  // A final line without a linebreak.
+
+      // Use whatever type fieldCount has but make sure it's not const (or volatile).
+      typename std::remove_cv<decltype(fieldCount)>::type fieldIndex = 0;
+      const char* fieldBegin = lineBegin;
+      bool tooManyFields = false;
+      for (const char* p = lineBegin; p != lineEnd; ++p) {
+         if (*p != ',') continue;
+         if (fieldIndex == fieldCount - 1) {
+            // To many tokens.  Columns are 1-based, like lines.
+            errors.push_back(std::to_string(line) + ":" +
+               std::to_string(p - lineBegin + 1) +
+               ": entry expected to be final; got \',\'");
+            tooManyFields = true;
+            break;
+         }
+         fields[fieldIndex++] = boost::string_view(fieldBegin, p - fieldBegin);
+         fieldBegin = p + 1;
+      }
 
-   while ((nextChar = iStream.peek()) != std::istream::traits_type::eof()) {
-      if (nextChar == '\n') {
-         if (fieldIndex < fieldCount - 1 /*&& column > 1*/) {
+      if (!tooManyFields) {
+         fields[fieldIndex] = boost::string_view(fieldBegin, lineEnd - fieldBegin);
+         if (fieldIndex < fieldCount - 1) {
             // Missing tokens.
-            errors.push_back(std::to_string(line) + ":" + std::to_string(column) +
+            errors.push_back(std::to_string(line) + ":" +
+               std::to_string(lineEnd - lineBegin + 1) +
                ": additional entry expected before linebreak");
          }
-         else if (fieldIndex == fieldCount - 1) {
+         else {
             resources.push_back(Tuple{});
             try {
                loadResources(resources.back(), extractors, fields);
@@ -75,87 +97,94 @@ loadResources(std::istream&& iStream, Extractors extractors,
                errors.push_back(std::to_string(line) + ": unknown parsing error: ");
             }
          }
-         for (auto& s : fields) {
-            s.clear();
-         }
-         ++line; column = 0; fieldIndex = 0;
-      }
-      else if (nextChar == ',') {
-         if (++fieldIndex > fieldCount - 1) {
-            // To many tokens.
-            errors.push_back(std::to_string(line) + ":" + std::to_string(column) +
-               ": entry expected to be final; got \'" + nextChar + "'");
-            iStream.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-            iStream.unget();
-            continue;
-         }
-      }
-      else {
-         fields[fieldIndex].push_back(nextChar);
       }
 
-      iStream.seekg(1, std::ios_base::cur);
-      ++column;
+      lineBegin = next;
    }
 
    return resources;
 }
 
-auto getName = [](const std::string& s) -> std::string {
+template <typename Tuple, typename Extractors>
+std::vector<Tuple>
+loadResources(std::istream&& iStream, Extractors extractors,
+              std::vector<std::string>& errors)
+{
+   const std::string contents{std::istreambuf_iterator<char>{iStream},
+                              std::istreambuf_iterator<char>{}};
+   return loadResources<Tuple>(contents.data(), contents.data() + contents.size(),
+                               extractors, errors);
+}
+
+const auto getName = [](boost::string_view s) -> std::string {
    if (s.empty()) throw std::string{"name expected, got nothing"};
-   static std::string pattern{R"([[:L*:] ]+)"};
-   static auto regEx = boost::make_u32regex(pattern);
-   if (!boost::u32regex_match(s, regEx)) {
-      throw std::string{"regex '" + pattern + "' doesn't match name '" + s + "'"};
+   static const std::string pattern{R"([[:L*:] ]+)"};
+   static const auto regEx = boost::make_u32regex(pattern);
+   // The iterator overload treats a range of `char`s as UTF-8.
+   if (!boost::u32regex_match(s.begin(), s.end(), regEx)) {
+      throw std::string{"regex '" + pattern + "' doesn't match name '" + s.to_string() +
+         "'"};
    }
-   return s;
+   return s.to_string();
 };
 
-// For strength, speed, and lifetime.
-auto getInt = [](const std::string& s) -> int {
-   int i = 0;
-   if (!s.empty()) {
-      try {
-         i = std::stoi(s);
-      }
-      catch (const std::invalid_argument& e) {
-         throw std::string{"stoi: can't convert \'" + s + "\' to int"};
+// For strength, speed, and lifetime.  Accepts what `std::stoi` accepts: optional leading
+// whitespace, an optional sign, and at least one digit; anything after the digits is
+// ignored.
+const auto getInt = [](boost::string_view s) -> int {
+   if (s.empty()) return 0;
+   auto it = s.begin();
+   while (it != s.end() && std::isspace(static_cast<unsigned char>(*it))) ++it;
+   bool negative = false;
+   if (it != s.end() && (*it == '+' || *it == '-')) {
+      negative = *it == '-';
+      ++it;
+   }
+   if (it == s.end() || !std::isdigit(static_cast<unsigned char>(*it))) {
+      throw std::string{"stoi: can't convert \'" + s.to_string() + "\' to int"};
+   }
+   // Accumulate the negated value; the range of negative values is the larger one.
+   long long value = 0;
+   for (; it != s.end() && std::isdigit(static_cast<unsigned char>(*it)); ++it) {
+      value = 10 * value - (*it - '0');
+      if (value < INT_MIN) {
+         throw std::string{"stoi: \'" + s.to_string() + "\' is out of range of int"};
       }
-      catch (const std::out_of_range& e) {
-         throw std::string{"stoi: \'" + s + "\' is out of range of int"};
+   }
+   if (!negative) {
+      if (-value > INT_MAX) {
+         throw std::string{"stoi: \'" + s.to_string() + "\' is out of range of int"};
       }
+      value = -value;
    }
-   return i;
+   return static_cast<int>(value);
 };
 // http://stackoverflow.com/questions/7663709/convert-string-to-int-c
 // http://en.cppreference.com/w/cpp/string/basic_string/stol
 
-auto getPath = [](const std::string& s) -> std::string {
-   static boost::regex regEx;
-
+const auto getPath = [](boost::string_view s) -> std::string {
    // Writing regular expressions is easier when not having to consider s being empty.
-   if (s.empty()) return s;
+   if (s.empty()) return s.to_string();
 
    // http://stackoverflow.com/questions/537772/what-is-the-most-correct-regular
    // http://en.wikipedia.org/wiki/Path_%28computing%29#POSIX_pathname_definition
    // I'm not sure wether I should allow paths beginning with two slashes.
-   if (!boost::regex_match(s, boost::regex{R"([^\0]*)"})) {
-      throw std::string{"filename '" + s + "' contains the null character'"};
+   if (s.find('\0') != boost::string_view::npos) {
+      throw std::string{"filename '" + s.to_string() + "' contains the null character'"};
    }
 
-   // Only accept POSIX "Fully portable filenames".
-   regEx = R"(([A-Za-z0-9._][A-Za-z0-9._-]{0,13}(/+|$))*)";
-   if (!boost::regex_match(s, regEx)) {
-      throw std::string{"path '" + s + "' should be made up of POSIX \"fully " +
-         "portable filenames\""};
+   // Only accept POSIX "Fully portable filenames".  Compiled only once.
+   static const boost::regex portable{R"(([A-Za-z0-9._][A-Za-z0-9._-]{0,13}(/+|$))*)"};
+   if (!boost::regex_match(s.begin(), s.end(), portable)) {
+      throw std::string{"path '" + s.to_string() + "' should be made up of POSIX " +
+         "\"fully portable filenames\""};
    }
 
    // Don't accept consecutive slashes.
-   regEx = "//";
-   if (boost::regex_search(s, regEx)) {
-      throw std::string{"path '" + s + "' contains consecutive slashes"};
+   if (s.find("//") != boost::string_view::npos) {
+      throw std::string{"path '" + s.to_string() + "' contains consecutive slashes"};
    }
-   return s;
+   return s.to_string();
 };
 
 // vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,64 @@
+#include "scenario.hpp"
+
+#include <algorithm>  // min
+#include <array>      // array
+#include <cassert>    // assert
+#include <random>     // mt19937, uniform_int_distribution
+#include <utility>    // swap
+
+#include "creature.hpp"
+
+std::vector<World::CreatureInfo> scatterCreatures(const World& world,
+                                                  const Scenario& scenario) {
+   assert(world.isCached(scenario.left, scenario.top));
+   assert(world.isCached(scenario.left + scenario.width - 1,
+                         scenario.top + scenario.height - 1));
+
+   // Collect all water and land positions first, so picking a good position never needs
+   // more than one random number.
+   std::array<std::vector<World::Pos>, 2> positions;  // Water, land.
+   for (auto y = scenario.top; y < scenario.top + scenario.height; ++y) {
+      for (auto x = scenario.left; x < scenario.left + scenario.width; ++x) {
+         positions[world.isLand(x, y)].push_back(World::Pos{x, y});
+      }
+   }
+
+   std::mt19937 rNG{scenario.seed};
+   std::vector<World::CreatureInfo> creatures;
+   // The number of positions at the front of each vector that plants took.
+   std::array<std::size_t, 2> numVegetated{};
+   const auto& types = Creature::getTypes();
+   for (std::size_t typeIndex = 0; typeIndex < types.size(); ++typeIndex) {
+      const CreatureType& type = types[typeIndex];
+      auto& candidates = positions[type.isTerrestrial()];
+      if (candidates.empty()) continue;
+      const Creature creature{static_cast<std::uint8_t>(typeIndex)};
+      if (type.isPlant()) {
+         // At most one plant per tile, like `spawnOffspring`: draw the tiles without
+         // replacement (a partial Fisher-Yates shuffle shared by all plant types).
+         std::size_t& numTaken = numVegetated[type.isTerrestrial()];
+         const std::size_t count =
+             std::min(scenario.plantsPerType, candidates.size() - numTaken);
+         for (std::size_t n = 0; n < count; ++n, ++numTaken) {
+            std::uniform_int_distribution<std::size_t> dist{numTaken,
+                                                            candidates.size() - 1};
+            std::swap(candidates[numTaken], candidates[dist(rNG)]);
+            creatures.emplace_back(candidates[numTaken], creature);
+         }
+      } else {
+         std::uniform_int_distribution<std::size_t> dist{0, candidates.size() - 1};
+         for (std::size_t n = 0; n < scenario.animalsPerType; ++n) {
+            creatures.emplace_back(candidates[dist(rNG)], creature);
+         }
+      }
+   }
+   return creatures;
+}
+
+void populate(World& world, const Scenario& scenario) {
+   world.updateTerrainCache(scenario.left, scenario.top, scenario.width - 1,
+                            scenario.height - 1);
+   world.spawnCreatures(scatterCreatures(world, scenario));
+}
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,38 @@
+#ifndef SCENARIO_HPP_TB3RU8KD
+#define SCENARIO_HPP_TB3RU8KD
+
+#include <cstddef>  // size_t
+#include <cstdint>  // int64_t, uint32_t
+#include <vector>   // vector
+
+#include "world.hpp"
+
+// A reproducible initial population for stress testing.  The same seed always scatters
+// the same creatures over the same area (given the same creature table).
+struct Scenario {
+   std::uint32_t seed = 0;
+   std::size_t plantsPerType = 0;
+   std::size_t animalsPerType = 0;
+
+   // The area to populate.  It's cached by `populate` and must fit into the cached
+   // terrain.  Anything larger than `MapGenerator::blockSize` in either direction only
+   // fits when aligned to terrain blocks; the default is the largest area that fits.
+   std::int64_t left = 0;
+   std::int64_t top = 0;
+   std::int64_t width = 2 * MapGenerator::blockSize;
+   std::int64_t height = 2 * MapGenerator::blockSize;
+};
+
+// Randomly pick positions inside the scenario's area for `plantsPerType` plants and
+// `animalsPerType` animals of every type.  Only good positions (see
+// `World::isGoodPosition`) are used.  Every plant gets a tile of its own, so plants run
+// out once all good tiles are taken; several animals can end up on the same tile.  Types
+// for which the area has no good position are skipped.  The area has to be cached.
+std::vector<World::CreatureInfo> scatterCreatures(const World&, const Scenario&);
+
+// Cache the scenario's area and add its creatures to the world with a single bulk insert.
+void populate(World&, const Scenario&);
+
+#endif  // SCENARIO_HPP_TB3RU8KD
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,182 @@
+#include "species_cache.hpp"
+
+#include <cstdint>  // uint8_t, uint16_t, uint32_t, uint64_t
+#include <cstdio>   // std::rename, std::remove
+#include <cstring>  // std::memcpy
+#include <fstream>  // ifstream, ofstream
+#include <tuple>    // std::get
+
+#include "creature_parser.hpp"
+#include "mapped_file.hpp"
+
+namespace {
+// Written in native byte order; a cache from a machine with the other byte order doesn't
+// match the magic number and is simply recompiled.
+constexpr std::uint32_t magic = 0x43535246;  // "FRSC" on little-endian machines.
+constexpr std::uint32_t version = 1;
+
+struct Header {
+   std::uint32_t magic;
+   std::uint32_t version;
+   std::uint64_t textHash;
+   std::uint64_t textSize;
+   std::uint32_t numTypes;
+   std::uint32_t numErrors;
+};
+
+// 64-bit FNV-1a.
+std::uint64_t hashText(const char* first, const char* last) {
+   std::uint64_t hash = 14695981039346656037ull;
+   for (; first != last; ++first) {
+      hash ^= static_cast<unsigned char>(*first);
+      hash *= 1099511628211ull;
+   }
+   return hash;
+}
+
+class Writer {
+  public:
+   template <typename T>
+   void put(const T& value) {
+      const auto bytes = reinterpret_cast<const char*>(&value);
+      buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+   }
+   void put(const std::string& s) {
+      put(static_cast<std::uint32_t>(s.size()));
+      buffer.insert(buffer.end(), s.begin(), s.end());
+   }
+   const std::vector<char>& data() const { return buffer; }
+
+  private:
+   std::vector<char> buffer;
+};
+
+// Reads what `Writer` wrote.  Running past the end of the buffer (a truncated cache)
+// makes `ok` return false instead of reading out of bounds.
+class Reader {
+  public:
+   Reader(const char* first, const char* last) : it{first}, last{last} {}
+
+   template <typename T>
+   T get() {
+      T value{};
+      if (static_cast<std::size_t>(last - it) < sizeof(T)) {
+         it = last;
+         good = false;
+      } else {
+         std::memcpy(&value, it, sizeof(T));
+         it += sizeof(T);
+      }
+      return value;
+   }
+   std::string getString() {
+      const auto size = get<std::uint32_t>();
+      if (static_cast<std::size_t>(last - it) < size) {
+         it = last;
+         good = false;
+         return {};
+      }
+      std::string s{it, size};
+      it += size;
+      return s;
+   }
+   bool ok() const { return good && it == last; }
+
+  private:
+   const char* it;
+   const char* last;
+   bool good = true;
+};
+
+std::string cachePath(const std::string& filePath) { return filePath + ".cache"; }
+
+bool readCache(const std::string& path, std::uint64_t textHash, std::uint64_t textSize,
+               std::vector<CreatureType>& creatureTypes,
+               std::vector<std::string>& errors) {
+   std::ifstream iStream{path, std::ios::binary | std::ios::ate};
+   if (!iStream.is_open()) return false;
+   const auto size = static_cast<std::size_t>(iStream.tellg());
+   if (size < sizeof(Header)) return false;
+   std::vector<char> buffer(size);
+   iStream.seekg(0);
+   if (!iStream.read(buffer.data(), static_cast<std::streamsize>(size))) return false;
+
+   Reader reader{buffer.data(), buffer.data() + buffer.size()};
+   const auto header = reader.get<Header>();
+   if (header.magic != magic || header.version != version ||
+       header.textHash != textHash || header.textSize != textSize) {
+      return false;
+   }
+   std::vector<CreatureType> types(header.numTypes);
+   for (auto& type : types) {
+      std::get<cTFields::name>(type.tuple) = reader.getString();
+      std::get<cTFields::strength>(type.tuple) = reader.get<std::int32_t>();
+      std::get<cTFields::speed>(type.tuple) = reader.get<std::int32_t>();
+      std::get<cTFields::lifetime>(type.tuple) = reader.get<std::int16_t>();
+      std::get<cTFields::attributes>(type.tuple).bitset = reader.get<std::uint8_t>();
+      std::get<cTFields::bitmap>(type.tuple) = reader.getString();
+   }
+   std::vector<std::string> cachedErrors(header.numErrors);
+   for (auto& error : cachedErrors) error = reader.getString();
+   if (!reader.ok()) return false;
+
+   creatureTypes = std::move(types);
+   errors.insert(errors.end(), cachedErrors.begin(), cachedErrors.end());
+   return true;
+}
+
+void writeCache(const std::string& path, std::uint64_t textHash, std::uint64_t textSize,
+                const std::vector<CreatureType>& creatureTypes,
+                const std::vector<std::string>& errors) {
+   Writer writer;
+   writer.put(Header{magic, version, textHash, textSize,
+                     static_cast<std::uint32_t>(creatureTypes.size()),
+                     static_cast<std::uint32_t>(errors.size())});
+   for (const auto& type : creatureTypes) {
+      writer.put(type.getName());
+      writer.put(static_cast<std::int32_t>(type.getStrength()));
+      writer.put(static_cast<std::int32_t>(type.getSpeed()));
+      writer.put(type.getMaxLifetime());
+      writer.put(static_cast<std::uint8_t>(
+          std::get<cTFields::attributes>(type.tuple).bitset.to_ulong()));
+      writer.put(type.getBitmapName());
+   }
+   for (const auto& error : errors) writer.put(error);
+
+   // Write to a temporary file and rename it, so a concurrently starting process never
+   // sees a half-written cache.
+   const auto tempPath = path + ".tmp";
+   {
+      std::ofstream oStream{tempPath, std::ios::binary | std::ios::trunc};
+      if (!oStream.is_open()) return;
+      const auto& data = writer.data();
+      oStream.write(data.data(), static_cast<std::streamsize>(data.size()));
+      if (!oStream.flush()) {
+         oStream.close();
+         std::remove(tempPath.c_str());
+         return;
+      }
+   }
+   if (std::rename(tempPath.c_str(), path.c_str()) != 0) std::remove(tempPath.c_str());
+}
+}
+
+std::vector<CreatureType> loadCreatureTypesCached(const std::string& filePath,
+                                                  std::vector<std::string>& errors) {
+   const MappedFile file{filePath};
+   const auto textHash = hashText(file.begin(), file.end());
+   const auto path = cachePath(filePath);
+
+   std::vector<CreatureType> creatureTypes;
+   if (readCache(path, textHash, file.size(), creatureTypes, errors)) {
+      return creatureTypes;
+   }
+
+   std::vector<std::string> parseErrors;
+   creatureTypes = loadCreatureTypes(file.begin(), file.end(), parseErrors);
+   writeCache(path, textHash, file.size(), creatureTypes, parseErrors);
+   errors.insert(errors.end(), parseErrors.begin(), parseErrors.end());
+   return creatureTypes;
+}
+
+// vim: tw=90 sts=-1 sw=3 et
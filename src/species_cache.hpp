@@ -0,0 +1,23 @@
+#ifndef SPECIES_CACHE_HPP_T4WQ9HZD
+#define SPECIES_CACHE_HPP_T4WQ9HZD
+
+#include <string>  // string
+#include <vector>  // vector
+
+#include "creature_type.hpp"
+
+// A compiled binary form of a creature table, stored next to it as `<table>.cache`.  The
+// cache records a hash of the text it was compiled from; as long as the text is
+// unchanged, the creature types (and the errors the parser reported) are read back with a
+// single read and without running any of the validating regexes.
+
+// Loads the creature types from the cache if it matches the table at `filePath`.
+// Otherwise, parses the table with `loadCreatureTypes` and tries to (re)write the cache;
+// failing to write it is not an error.  Throws `std::runtime_error` if the table can't be
+// opened.
+std::vector<CreatureType> loadCreatureTypesCached(const std::string& filePath,
+                                                  std::vector<std::string>& errors);
+
+#endif  // SPECIES_CACHE_HPP_T4WQ9HZD
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,81 @@
+#include "step_stats.hpp"
+
+#include <algorithm>  // std::fill, std::none_of
+#include <cassert>    // assert
+
+namespace {
+const char* const counterNames[] = {
+    "births",        "deaths",          "moves",             "path_calls",
+    "path_nodes",    "path_clusters",   "path_cache_hits",   "unreachable_paths",
+    "bfs_nodes",     "count_lookups",   "terrain_blocks",    "refused_spawns",
+    "skipped_searches"};
+const char* const behaviorNames[] = {"none", "grow",    "decide",  "roam",
+                                     "procreate", "hunt", "consume", "rest"};
+
+static_assert(sizeof(counterNames) / sizeof(*counterNames) == toUT(Counter::SIZE),
+              "a counter is missing a name");
+static_assert(sizeof(behaviorNames) / sizeof(*behaviorNames) == toUT(Behavior::SIZE),
+              "a behavior is missing a name");
+
+void writeCounters(std::ostream& oS, const Counters& counters) {
+   for (auto value : counters) {
+      oS << ',' << value;
+   }
+   oS << '\n';
+}
+}
+
+const char* getName(Counter counter) { return counterNames[toUT(counter)]; }
+
+StepStats::StepStats(std::size_t capacity) : records(capacity) { assert(capacity > 0); }
+
+void StepStats::beginStep(int step, std::size_t numTypes) {
+   this->numTypes = numTypes;
+   current = &records[next];
+   next = (next + 1) % records.size();
+   if (count < records.size()) ++count;
+
+   current->step = step;
+   current->total.fill(0);
+   // Resizing only allocates while the buffer fills up (or when types are added).
+   current->breakdown.resize((numTypes + 1) * toUT(Behavior::SIZE));
+   std::fill(current->breakdown.begin(), current->breakdown.end(), Counters{});
+   clearActor();
+}
+
+std::size_t StepStats::size() const { return count; }
+
+const StepRecord& StepStats::operator[](std::size_t index) const {
+   assert(index < count);
+   return records[(next + records.size() - count + index) % records.size()];
+}
+
+void StepStats::writeCsv(std::ostream& oS) const {
+   oS << "step,type,behavior";
+   for (auto name : counterNames) {
+      oS << ',' << name;
+   }
+   oS << '\n';
+   for (std::size_t i = 0; i < size(); ++i) {
+      const StepRecord& record = (*this)[i];
+      oS << record.step << ",,";
+      writeCounters(oS, record.total);
+      const std::size_t numRows = record.breakdown.size() / toUT(Behavior::SIZE);
+      for (std::size_t type = 0; type < numRows; ++type) {
+         for (std::size_t b = 0; b < toUT(Behavior::SIZE); ++b) {
+            const Counters& counters = record.at(type, static_cast<Behavior>(b));
+            if (std::none_of(counters.begin(), counters.end(),
+                             [](std::uint32_t n) { return n != 0; })) {
+               continue;
+            }
+            oS << record.step << ',';
+            // The last row isn't attributed to any creature type.
+            if (type + 1 != numRows) oS << type;
+            oS << ',' << behaviorNames[b];
+            writeCounters(oS, counters);
+         }
+      }
+   }
+}
+
+// vim: tw=90 sts=-1 sw=3 et
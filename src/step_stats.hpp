@@ -0,0 +1,133 @@
+#ifndef STEP_STATS_HPP_Q7MZC2WE
+#define STEP_STATS_HPP_Q7MZC2WE
+
+#include <array>    // array
+#include <cstddef>  // size_t
+#include <cstdint>  // uint8_t, uint32_t
+#include <ostream>  // ostream
+#include <vector>   // vector
+
+#include "tuple_helpers.hpp"  // toUT
+
+// What is being counted.  Work done by searches is measured in visited positions.
+enum class Counter : std::uint8_t {
+   births = 0,
+   deaths,
+   moves,
+   pathCalls,         // Searches run by `World::getPath`.
+   pathNodes,         // Positions (and cluster entrances) expanded by `World::getPath`.
+   pathClusters,      // Clusters connected when rebuilding the `PathHierarchy`.
+   pathCacheHits,     // Calls to `World::getPath` answered from the cache.
+   unreachablePaths,  // Calls to `World::getPath` whose `dest` is in another region.
+   bfsNodes,          // Positions visited by `World::getReachable*`.
+   countLookups,      // Positions (or Z-order cells) `World::countCreatures` looked up.
+   terrainBlocks,     // Terrain blocks generated by the `MapGenerator`.
+   refusedSpawns,     // Offspring and creatures not spawned because of the memory cap.
+   skippedSearches,   // Searches of `World::findFood` skipped as they'd find nothing.
+   SIZE
+};
+
+// What a creature was doing when a counter was incremented.  `decide` is the work done by
+// `World::getNewAnimalState`, `grow` is everything done by `World::updatePlant`.
+enum class Behavior : std::uint8_t {
+   none = 0,
+   grow,
+   decide,
+   roam,
+   procreate,
+   hunt,
+   consume,
+   rest,
+   SIZE
+};
+
+using Counters = std::array<std::uint32_t, toUT(Counter::SIZE)>;
+
+// The name used for the counter's column in CSV output, e.g. "path_calls".
+const char* getName(Counter);
+
+// The counters of a single step.  Besides the totals, every counter is broken down by the
+// type index of the creature that was active and by what it was doing.
+struct StepRecord {
+   inline Counters& at(std::size_t typeIndex, Behavior);
+   inline const Counters& at(std::size_t typeIndex, Behavior) const;
+
+   int step = 0;
+   Counters total{};
+   // `numTypes + 1` rows of `Behavior::SIZE` counter arrays.  The last row holds work
+   // that can't be attributed to any creature (e.g. generating terrain).
+   std::vector<Counters> breakdown;
+};
+
+// Keeps the counters of the last `capacity` steps in a ring buffer.
+class StepStats {
+  public:
+   explicit StepStats(std::size_t capacity = 256);
+
+   // Start recording a new step; overwrites the oldest record once the buffer is full.
+   void beginStep(int step, std::size_t numTypes);
+
+   // Attribute subsequent counts to a creature type and behavior.
+   inline void setActor(std::uint8_t typeIndex, Behavior);
+   inline void setBehavior(Behavior);
+   inline void clearActor();
+
+   // Count towards the current actor.
+   inline void add(Counter, std::uint32_t n = 1);
+   // Count towards a specific creature type; e.g. a creature eaten by the current actor.
+   inline void add(std::uint8_t typeIndex, Behavior, Counter, std::uint32_t n = 1);
+
+   // Records are ordered from the oldest (index 0) to the most recent one.
+   std::size_t size() const;
+   const StepRecord& operator[](std::size_t) const;
+
+   // Write one line per step, type index and behavior with nonzero counters and one line
+   // per step with the totals (its `type` column is empty).
+   void writeCsv(std::ostream&) const;
+
+  private:
+   std::vector<StepRecord> records;
+   std::size_t next = 0;  // The record `beginStep` overwrites next.
+   std::size_t count = 0;
+   std::size_t numTypes = 0;
+   StepRecord* current = nullptr;
+   std::size_t actorType = 0;
+   Behavior actorBehavior = Behavior::none;
+};
+
+Counters& StepRecord::at(std::size_t typeIndex, Behavior behavior) {
+   return breakdown[typeIndex * toUT(Behavior::SIZE) + toUT(behavior)];
+}
+
+const Counters& StepRecord::at(std::size_t typeIndex, Behavior behavior) const {
+   return breakdown[typeIndex * toUT(Behavior::SIZE) + toUT(behavior)];
+}
+
+void StepStats::setActor(std::uint8_t typeIndex, Behavior behavior) {
+   actorType = typeIndex;
+   actorBehavior = behavior;
+}
+
+void StepStats::setBehavior(Behavior behavior) { actorBehavior = behavior; }
+
+void StepStats::clearActor() {
+   actorType = numTypes;
+   actorBehavior = Behavior::none;
+}
+
+void StepStats::add(Counter counter, std::uint32_t n) {
+   if (!current) return;
+   current->total[toUT(counter)] += n;
+   current->at(actorType, actorBehavior)[toUT(counter)] += n;
+}
+
+void StepStats::add(std::uint8_t typeIndex, Behavior behavior, Counter counter,
+                    std::uint32_t n) {
+   if (!current) return;
+   current->total[toUT(counter)] += n;
+   current->at(typeIndex, behavior)[toUT(counter)] += n;
+}
+
+#endif  // STEP_STATS_HPP_Q7MZC2WE
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,204 @@
+#include "targa.hpp"
+
+#include <algorithm>  // std::fill, std::reverse, std::swap_ranges
+#include <cstdint>    // uint8_t, uint16_t
+#include <cstring>    // std::memcpy
+#include <fstream>    // ifstream
+#include <stdexcept>  // runtime_error
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TARGA_HAVE_SSSE3_PATH
+#include <tmmintrin.h>  // _mm_shuffle_epi8
+#endif
+
+using std::uint8_t;
+using std::uint16_t;
+
+using Quadlet = TargaImage::Quadlet;
+
+namespace {
+// 18 bytes, always.
+struct TargaHeader {
+   uint8_t iDLength;
+   uint8_t colorMapType;
+   uint8_t imageType;
+   struct ColorMapSpecification {
+      uint16_t firstEntryIndex;
+      uint16_t length;
+      uint8_t entrySize;
+   } __attribute__((packed)) colorMapSpecification;
+   struct ImageSpecification {
+      uint16_t xOrigin;
+      uint16_t yOrigin;
+      uint16_t width;
+      uint16_t height;
+      uint8_t pixelDepth;
+      uint8_t imageDescriptor;
+   } __attribute__((packed)) imageSpecification;
+} __attribute__((packed));
+
+enum ImageType : uint8_t {
+   trueColor = 2,
+   grayscale = 3,
+   rleTrueColor = 10,
+   rleGrayscale = 11
+};
+
+// Bits of the image descriptor.
+enum : uint8_t { rightToLeft = 1 << 4, topToBottom = 1 << 5 };
+
+void expandBGRScalar(const uint8_t* src, Quadlet* dst, std::size_t n) {
+   for (std::size_t i = 0; i < n; ++i, src += 3) {
+      dst[i] = Quadlet{{src[0], src[1], src[2], 0xff}};
+   }
+}
+
+#ifdef TARGA_HAVE_SSSE3_PATH
+// Spread four 3-byte pixels over 16 bytes with one shuffle and fill in the alpha bytes.
+__attribute__((target("ssse3")))
+void expandBGRSSSE3(const uint8_t* src, Quadlet* dst, std::size_t n) {
+   const __m128i shuffle =
+       _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+   const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000u));
+   std::size_t i = 0;
+   // Each load reads 16 bytes but only uses 12 of them; stop before it reads past `src`.
+   for (; i + 6 <= n; i += 4) {
+      auto bgr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * i));
+      auto bgra = _mm_or_si128(_mm_shuffle_epi8(bgr, shuffle), alpha);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), bgra);
+   }
+   expandBGRScalar(src + 3 * i, dst + i, n - i);
+}
+#endif
+
+// Turn `n` 24-bit pixels into opaque quadlets.
+void expandBGR(const uint8_t* src, Quadlet* dst, std::size_t n) {
+#ifdef TARGA_HAVE_SSSE3_PATH
+   static const bool haveSSSE3 = __builtin_cpu_supports("ssse3");
+   if (haveSSSE3) {
+      expandBGRSSSE3(src, dst, n);
+      return;
+   }
+#endif
+   expandBGRScalar(src, dst, n);
+}
+
+void expandGray(const uint8_t* src, Quadlet* dst, std::size_t n) {
+   for (std::size_t i = 0; i < n; ++i) {
+      dst[i] = Quadlet{{src[i], src[i], src[i], 0xff}};
+   }
+}
+
+void convertPixels(const uint8_t* src, Quadlet* dst, std::size_t n,
+                   std::size_t bytesPerPixel) {
+   switch (bytesPerPixel) {
+      case 1: expandGray(src, dst, n); break;
+      case 3: expandBGR(src, dst, n); break;
+      case 4: std::memcpy(dst, src, 4 * n); break;
+   }
+}
+
+// Decode run-length encoded pixel data.  Each packet starts with a byte whose high bit
+// tells a run (one pixel repeated) from a raw packet (pixels stored as is); the other
+// bits are the number of pixels minus one.  Packets may cross rows but not the end of
+// the image.
+void decodeRLE(const uint8_t* in, const uint8_t* inEnd, Quadlet* out,
+               Quadlet* outEnd, std::size_t bytesPerPixel) {
+   const std::runtime_error truncated{"RLE pixel data is truncated"};
+   while (out != outEnd) {
+      if (in == inEnd) throw truncated;
+      const uint8_t packet = *in++;
+      const std::size_t count = (packet & 0x7f) + 1u;
+      if (count > static_cast<std::size_t>(outEnd - out)) {
+         throw std::runtime_error{"RLE packet crosses the end of the image"};
+      }
+      const bool isRun = packet & 0x80;
+      const std::size_t packetBytes = isRun ? bytesPerPixel : count * bytesPerPixel;
+      if (static_cast<std::size_t>(inEnd - in) < packetBytes) throw truncated;
+      if (isRun) {
+         convertPixels(in, out, 1, bytesPerPixel);
+         std::fill(out + 1, out + count, *out);
+      } else {
+         convertPixels(in, out, count, bytesPerPixel);
+      }
+      in += packetBytes;
+      out += count;
+   }
+}
+}
+
+TargaImage loadTarga(const std::string& path) {
+   std::ifstream iS{path, std::ios::binary | std::ios::in};
+   if (!iS.is_open()) {
+      throw std::runtime_error{"Can't open file: \"" + path + '"'};
+   }
+   iS.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+   TargaHeader targaHeader;
+   iS.read(reinterpret_cast<char*>(&targaHeader), sizeof(targaHeader));
+   auto imageSpec = targaHeader.imageSpecification;
+
+
+   const auto imageType = targaHeader.imageType;
+   const bool isGray = imageType == grayscale || imageType == rleGrayscale;
+   const bool isRLE = imageType == rleTrueColor || imageType == rleGrayscale;
+   if (imageType != trueColor && imageType != grayscale && imageType != rleTrueColor &&
+       imageType != rleGrayscale) {
+      throw std::runtime_error{"Only true-color and grayscale images are supported"};
+   }
+   const std::size_t bytesPerPixel = imageSpec.pixelDepth / 8;
+   if (isGray ? imageSpec.pixelDepth != 8
+              : imageSpec.pixelDepth != 24 && imageSpec.pixelDepth != 32) {
+      throw std::runtime_error{
+          "Only 24 or 32 bits per pixel (8 for grayscale images) are supported"};
+   }
+
+   // Skip the optional image ID field and the color map data, if any.
+   const auto& colorMapSpec = targaHeader.colorMapSpecification;
+   iS.ignore(targaHeader.iDLength +
+             colorMapSpec.length * ((colorMapSpec.entrySize + 7) / 8));
+
+   TargaImage image;
+   const std::size_t numRows = image.height = imageSpec.height;
+   const std::size_t numCols = image.width = imageSpec.width;
+   const std::size_t numPixels = numRows * numCols;
+   image.pixels.resize(numPixels);
+   auto* quadlets = image.pixels.data();
+
+   // Now get the pixel data with a single read.
+   std::vector<uint8_t> data;
+   if (isRLE) {
+      // The size of the compressed data isn't stored anywhere; read the rest of the
+      // file.
+      const auto begin = iS.tellg();
+      iS.seekg(0, std::ios::end);
+      data.resize(static_cast<std::size_t>(iS.tellg() - begin));
+      iS.seekg(begin);
+   } else {
+      data.resize(numPixels * bytesPerPixel);
+   }
+   iS.read(reinterpret_cast<char*>(data.data()), data.size());
+   if (isRLE) {
+      decodeRLE(data.data(), data.data() + data.size(), quadlets,
+                quadlets + numPixels, bytesPerPixel);
+   } else {
+      convertPixels(data.data(), quadlets, numPixels, bytesPerPixel);
+   }
+
+   // Normalize the orientation to rows going upwards and columns going to the right.
+   const auto rowBegin = [=](std::size_t row) {
+      return quadlets + row * numCols;
+   };
+   if (imageSpec.imageDescriptor & topToBottom) {
+      for (std::size_t row = 0; row < numRows / 2; ++row) {
+         std::swap_ranges(rowBegin(row), rowBegin(row + 1), rowBegin(numRows - 1 - row));
+      }
+   }
+   if (imageSpec.imageDescriptor & rightToLeft) {
+      for (std::size_t row = 0; row < numRows; ++row) {
+         std::reverse(rowBegin(row), rowBegin(row + 1));
+      }
+   }
+   return image;
+}
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,28 @@
+#ifndef TARGA_HPP_H2RK6DYE
+#define TARGA_HPP_H2RK6DYE
+
+#include <array>    // array
+#include <cstddef>  // size_t
+#include <cstdint>  // uint8_t
+#include <string>   // string
+#include <vector>   // vector
+
+// A decoded TGA image.  Pixels keep the byte order of the file, i.e. blue, green, red,
+// alpha; rows go from the bottom to the top.
+struct TargaImage {
+   using Quadlet = std::array<std::uint8_t, 4>;
+
+   std::size_t width = 0;
+   std::size_t height = 0;
+   std::vector<Quadlet> pixels;
+};
+
+// Decode an uncompressed or run-length encoded true-color (24 or 32 bits per pixel) or
+// grayscale (8 bits per pixel) TGA file.  Touches no global state, so several files can
+// be decoded in parallel.  Throws `std::runtime_error` if the file can't be read or
+// isn't supported.
+TargaImage loadTarga(const std::string& path);
+
+#endif  // TARGA_HPP_H2RK6DYE
+
+// vim: tw=90 sts=-1 sw=3 et
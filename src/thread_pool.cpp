@@ -0,0 +1,91 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>  // std::max
+
+namespace {
+// The pool the current thread works for and the index of its queue.
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local std::size_t currentIndex = 0;
+}
+
+ThreadPool::ThreadPool(unsigned numThreads) {
+   // `hardware_concurrency` returns 0 if it can't tell.
+   numThreads = std::max(numThreads, 1u);
+   queues.reserve(numThreads);
+   for (unsigned i = 0; i < numThreads; ++i) {
+      queues.push_back(std::make_unique<Queue>());
+   }
+   workers.reserve(numThreads);
+   for (unsigned i = 0; i < numThreads; ++i) {
+      workers.emplace_back(&ThreadPool::work, this, i);
+   }
+}
+
+ThreadPool::~ThreadPool() {
+   {
+      std::lock_guard<std::mutex> lock{mutex};
+      stopping = true;
+   }
+   taskAvailable.notify_all();
+   for (auto& worker : workers) {
+      worker.join();
+   }
+}
+
+void ThreadPool::post(std::function<void()> task) {
+   const std::size_t index =
+       currentPool == this ? currentIndex : nextQueue++ % queues.size();
+   // Count the task before it's visible, so a worker taking it right away can't
+   // decrement `pending` below zero.
+   {
+      std::lock_guard<std::mutex> lock{mutex};
+      ++pending;
+   }
+   {
+      std::lock_guard<std::mutex> lock{queues[index]->mutex};
+      queues[index]->tasks.push_back(std::move(task));
+   }
+   taskAvailable.notify_one();
+}
+
+bool ThreadPool::tryTake(std::size_t index, std::function<void()>& task) {
+   {
+      Queue& own = *queues[index];
+      std::lock_guard<std::mutex> lock{own.mutex};
+      if (!own.tasks.empty()) {
+         task = std::move(own.tasks.back());
+         own.tasks.pop_back();
+         --pending;
+         return true;
+      }
+   }
+   for (std::size_t i = 1; i < queues.size(); ++i) {
+      Queue& victim = *queues[(index + i) % queues.size()];
+      std::lock_guard<std::mutex> lock{victim.mutex};
+      if (!victim.tasks.empty()) {
+         task = std::move(victim.tasks.front());
+         victim.tasks.pop_front();
+         --pending;
+         return true;
+      }
+   }
+   return false;
+}
+
+void ThreadPool::work(std::size_t index) {
+   currentPool = this;
+   currentIndex = index;
+   for (;;) {
+      std::function<void()> task;
+      if (tryTake(index, task)) {
+         task();
+         continue;
+      }
+      std::unique_lock<std::mutex> lock{mutex};
+      taskAvailable.wait(lock, [this] { return stopping || pending > 0; });
+      // Drain the queues before stopping.
+      if (stopping && pending == 0) return;
+   }
+}
+
+// vim: tw=90 sts=-1 sw=3 et
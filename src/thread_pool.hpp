@@ -0,0 +1,77 @@
+#ifndef THREAD_POOL_HPP_5NCV2PJR
+#define THREAD_POOL_HPP_5NCV2PJR
+
+#include <atomic>              // atomic
+#include <condition_variable>  // condition_variable
+#include <cstddef>             // size_t
+#include <deque>               // deque
+#include <functional>          // function
+#include <future>              // future, packaged_task
+#include <memory>              // make_shared, unique_ptr
+#include <mutex>               // mutex
+#include <thread>              // thread
+#include <type_traits>         // result_of
+#include <utility>             // forward
+#include <vector>              // vector
+
+// A fixed number of worker threads with a task queue each.  A task posted by a worker
+// goes to the back of that worker's own queue, and workers take tasks from the back of
+// their own queue first, so a chain of tasks tends to stay on one thread (and in its
+// caches).  A worker whose queue is empty steals from the front of the other queues, so
+// no thread idles while there's work.  Tasks posted by other threads are spread over the
+// queues round-robin.
+class ThreadPool {
+  public:
+   // Start `numThreads` workers; by default, one per hardware thread.
+   explicit ThreadPool(unsigned numThreads = std::thread::hardware_concurrency());
+   // Finish all tasks posted so far (and the tasks they post) and join the workers.
+   ~ThreadPool();
+
+   ThreadPool(const ThreadPool&) = delete;
+   ThreadPool& operator=(const ThreadPool&) = delete;
+
+   // Queue `task` for execution on a worker.
+   void post(std::function<void()> task);
+
+   // Like `post`, but the returned future yields the result of `f` or rethrows the
+   // exception it exited with.
+   template <typename F>
+   std::future<typename std::result_of<F()>::type> submit(F&& f);
+
+   std::size_t size() const { return workers.size(); }
+
+  private:
+   struct Queue {
+      std::mutex mutex;
+      std::deque<std::function<void()>> tasks;
+   };
+
+   // Take a task from the back of queue `index` or, failing that, steal one from the
+   // front of another queue.
+   bool tryTake(std::size_t index, std::function<void()>& task);
+   void work(std::size_t index);
+
+   std::vector<std::unique_ptr<Queue>> queues;
+   std::vector<std::thread> workers;
+   // Tasks in all queues, and tasks about to be pushed.  Changed under `mutex` when
+   // increasing, so a worker can't miss a task while going to sleep.
+   std::atomic<std::size_t> pending{0};
+   std::atomic<std::size_t> nextQueue{0};  // For round-robin posting.
+   std::mutex mutex;
+   std::condition_variable taskAvailable;
+   bool stopping = false;
+};
+
+template <typename F>
+std::future<typename std::result_of<F()>::type> ThreadPool::submit(F&& f) {
+   using Result = typename std::result_of<F()>::type;
+   // `std::function` needs a copyable target, which `std::packaged_task` isn't.
+   auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+   auto future = task->get_future();
+   post([task] { (*task)(); });
+   return future;
+}
+
+#endif  // THREAD_POOL_HPP_5NCV2PJR
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,125 @@
+#include "trace.hpp"
+
+#ifdef TRACE
+
+#include <atomic>     // atomic
+#include <cstddef>    // size_t
+#include <cstdint>    // uint32_t
+#include <fstream>    // ofstream
+#include <iomanip>    // setprecision
+#include <memory>     // unique_ptr
+#include <mutex>      // mutex, lock_guard
+#include <stdexcept>  // runtime_error
+#include <vector>     // vector
+
+namespace c4o = std::chrono;
+
+namespace {
+struct Event {
+   const char* name;
+   c4o::steady_clock::time_point startTime;
+   c4o::steady_clock::duration duration;
+};
+
+// Every thread records into its own buffer.  Its mutex is only contended by
+// `trace::stop`, which takes the events while other threads may still be recording zones.
+// A buffer is a ring of at most `capacity` events: once full, each zone overwrites the
+// oldest one, so a long session keeps its last zones in bounded memory.
+struct ThreadBuffer {
+   static constexpr std::size_t capacity = 1 << 20;
+
+   std::uint32_t threadId;
+   std::vector<Event> events;
+   std::size_t next = 0;  // Where the next event goes once the ring is full.
+   std::mutex mutex;
+
+   void add(const Event& event) {
+      if (events.size() < capacity) {
+         events.push_back(event);
+      } else {
+         events[next] = event;
+         next = (next + 1) % capacity;
+      }
+   }
+   // Copy the events, oldest first, to `out` and start over.
+   void take(std::vector<Event>& out) {
+      out.assign(events.begin() + next, events.end());
+      out.insert(out.end(), events.begin(), events.begin() + next);
+      events.clear();
+      next = 0;
+   }
+};
+
+constexpr std::size_t ThreadBuffer::capacity;
+
+std::atomic<bool> enabled{false};
+std::mutex buffersMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+std::string outputPath;
+c4o::steady_clock::time_point epoch;
+
+ThreadBuffer& getThreadBuffer() {
+   thread_local ThreadBuffer* buffer = nullptr;
+   if (!buffer) {
+      std::lock_guard<std::mutex> lock{buffersMutex};
+      auto threadId = static_cast<std::uint32_t>(buffers.size());
+      buffers.emplace_back(new ThreadBuffer{threadId, {}, 0, {}});
+      buffer = buffers.back().get();
+      buffer->events.reserve(1 << 16);
+   }
+   return *buffer;
+}
+
+double toMicroseconds(c4o::steady_clock::duration duration) {
+   return c4o::duration<double, std::micro>(duration).count();
+}
+}
+
+void trace::start(std::string filePath) {
+   outputPath = std::move(filePath);
+   epoch = c4o::steady_clock::now();
+   enabled = true;
+}
+
+void trace::stop() {
+   if (!enabled.exchange(false)) return;
+   std::ofstream oStream{outputPath};
+   if (!oStream.is_open()) {
+      throw std::runtime_error{u8"couldn't open file " + outputPath};
+   }
+   oStream << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+   bool first = true;
+   std::lock_guard<std::mutex> lock{buffersMutex};
+   std::vector<Event> events;
+   for (const auto& buffer : buffers) {
+      {
+         std::lock_guard<std::mutex> bufferLock{buffer->mutex};
+         buffer->take(events);
+      }
+      for (const auto& event : events) {
+         oStream << (first ? "\n" : ",\n") << "{\"name\":\"" << event.name
+                 << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+                 << ",\"ts\":" << toMicroseconds(event.startTime - epoch)
+                 << ",\"dur\":" << toMicroseconds(event.duration) << '}';
+         first = false;
+      }
+   }
+   oStream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+trace::Zone::Zone(const char* name)
+    : name{name}, recording{enabled.load(std::memory_order_relaxed)} {
+   if (recording) startTime = c4o::steady_clock::now();
+}
+
+trace::Zone::~Zone() {
+   if (!recording || !enabled.load(std::memory_order_relaxed)) return;
+   auto endTime = c4o::steady_clock::now();
+   ThreadBuffer& buffer = getThreadBuffer();
+   std::lock_guard<std::mutex> lock{buffer.mutex};
+   buffer.add(Event{name, startTime, endTime - startTime});
+}
+
+#endif  // TRACE
+
+// vim: tw=90 sts=-1 sw=3 et
@@ -0,0 +1,53 @@
+#ifndef TRACE_HPP_H4W0NPLS
+#define TRACE_HPP_H4W0NPLS
+
+// Scoped trace zones written as Chrome trace events [1] that can be viewed with
+// `chrome://tracing` or Perfetto.  Zones are only compiled in when `TRACE` is defined
+// (`make TRACE=1`); otherwise `TRACE_ZONE` expands to nothing.
+// [1]: http://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+
+#ifdef TRACE
+
+#include <chrono>  // steady_clock
+#include <string>  // string
+
+namespace trace {
+
+// Start recording zones.  They are written to `filePath` by `stop()`.
+void start(std::string filePath);
+
+// Stop recording and write the zones recorded so far; per thread, only the last million
+// or so are kept.  Threads still recording zones while this is called may have their
+// last zones cut off.
+void stop();
+
+// Records the time between its construction and destruction.  The name has to outlive
+// the recording; pass a string literal.
+class Zone {
+  public:
+   explicit Zone(const char* name);
+   ~Zone();
+
+   Zone(const Zone&) = delete;
+   Zone& operator=(const Zone&) = delete;
+
+  private:
+   const char* name;
+   bool recording;
+   std::chrono::steady_clock::time_point startTime;
+};
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) ::trace::Zone TRACE_CONCAT(traceZone, __LINE__) { name }
+
+#else
+
+#define TRACE_ZONE(name)
+
+#endif  // TRACE
+
+#endif  // TRACE_HPP_H4W0NPLS
+
+// vim: tw=90 sts=-1 sw=3 et
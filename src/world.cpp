@@ -1,26 +1,31 @@
-#include <algorithm>      // std::fill_n, std::max, std::min
+#include <algorithm>      // std::fill, std::max, std::min
 #include <cassert>        // assert
 #include <climits>        // CHAR_BIT
-#include <cmath>          // pow, lround, abs
-#include <cstdint>        // int64_t
+#include <cmath>          // pow, lround, abs, floor, log, log1p
+#include <cstdint>        // int64_t, uint32_t, SIZE_MAX
 #include <cstdlib>        // abs
-#include <memory>         // unique_ptr
-#include <queue>          // priority_queue, queue
+#include <functional>     // equal_to
+#include <iomanip>        // setfill, setprecision, setw
+#include <iostream>       // cerr
+#include <istream>        // istream, ws
+#include <iterator>       // next
+#include <limits>         // numeric_limits
+#include <ostream>        // ostream
 #include <random>         // std::default_random_engine, std::random_device, ...
+#include <stdexcept>      // runtime_error
 #include <unordered_map>  // unordered_map
+#include <utility>        // swap
 #include <vector>         // vector
 
-#ifdef DEBUG
-#include <iomanip>   // setfill, setw
-#include <iostream>  // cout, cerr
-#endif
-
+#include "trace.hpp"
 #include "world.hpp"
 
 namespace {
-std::default_random_engine rNG{std::random_device{}()};
-std::uniform_int_distribution<int> defaultRNDist{};  //  [0, numeric_limits<int>::max()]
-std::uniform_int_distribution<int> coinDist(0, 1);
+// Distributions can't be shared between threads, and worlds may be stepped on different
+// threads.  The engine is a member of `World`.
+thread_local std::uniform_int_distribution<int> defaultRNDist{};  //  [0, INT_MAX]
+thread_local std::uniform_int_distribution<int> coinDist(0, 1);
+thread_local std::uniform_real_distribution<double> unitDist{0., 1.};  // [0, 1)
 
 // The maximum value of a component of an animal's offset to the destination it's roaming
 // towards that can be stored.  While no destinations that are more than 10 tiles (in
@@ -38,6 +43,36 @@ constexpr std::uint16_t numRoamStates = roamDivisor * roamDivisor;  // 6561
 // AI state that indicates an animal is roaming but has reached its destination.  3280.
 // 3280 / 81 = 3280 % 81 = 40.
 constexpr std::uint16_t defaultRoamState = (numRoamStates - 1) / 2;
+
+// Round towards negative infinity.
+std::int64_t floorDiv(std::int64_t a, std::int64_t b) {
+   return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+// The passability of searches for animals, which stay in the medium they start in.
+struct SameMedium {
+   const World& world;
+   bool onLand;
+
+   bool operator()(const World::Pos& pos) const { return world.isLand(pos) == onLand; }
+};
+
+// The cost model of `World::getTilePath`, which estimates the cost to `dest` by the
+// distance.
+struct MovementCost {
+   static constexpr bool isUniform = false;
+
+   const World& world;
+   bool onLand;
+   World::Pos dest;
+
+   int operator()(const World::Pos& pos) const {
+      return world.getMovementCost(pos, onLand);
+   }
+   int estimate(const World::Pos& pos) const {
+      return static_cast<int>(distance(pos, dest));
+   }
+};
 }
 
 enum animalStates : std::uint16_t {
@@ -50,6 +85,14 @@ enum animalStates : std::uint16_t {
 };
 
 constexpr std::uint16_t defaultAiState = defaultRoamState;
+// Marks the animals `World::commitStepInZOrder` already copied to their destination.
+constexpr std::uint16_t movedMark = std::numeric_limits<std::uint16_t>::max();
+static_assert(animalStates::SIZE <= movedMark, "the mark would be a valid state");
+
+constexpr int World::maxFoodDist;
+constexpr int World::foodBlockSize;
+constexpr std::size_t World::pathCacheCapacity;
+constexpr std::size_t World::pathCacheBytes;
 
 // Get where an animal is moving towards relative to its current position.  Determined by
 // the animal's AI state.
@@ -90,27 +133,234 @@ World::Pos getRoamDest(const World::CreatureInfo& animalInfo) {
    return dest;
 }
 
+World::World() : World{std::random_device{}(), std::random_device{}()} {}
+
+World::World(MapGenerator::SeedType mapSeed) : World{mapSeed, std::random_device{}()} {}
+
+World::World(MapGenerator::SeedType mapSeed, World::SeedType seed)
+    : seed{seed}, mapGen{mapSeed} {
+   Creature::seedRNG(rNG());
+}
+
+void World::writeState(std::ostream& oStream) const {
+   assert(moveeCache.empty() && offspringCache.empty());
+   oStream << currentStep << ' ' << left << ' ' << top << '\n' << rNG << '\n';
+   // With the bucket counts, the rebuilt hash maps iterate in the same order as these.
+   oStream << creatures.bucket_count() << ' ' << creatures.size() << '\n';
+   for (const auto& creatureInfo : creatures) {
+      const Pos& pos = creatureInfo.first;
+      const Creature& creature = creatureInfo.second;
+      oStream << pos[0] << ' ' << pos[1] << ' ' << unsigned{creature.getTypeIndex()}
+              << ' ' << creature.lifetime << ' ' << creature.aiState << ' '
+              << unsigned{creature.procreationOffset} << '\n';
+   }
+   oStream << carcasses.bucket_count() << ' ' << carcasses.size() << '\n';
+   for (const auto& carcass : carcasses) {
+      oStream << carcass.first[0] << ' ' << carcass.first[1] << ' '
+              << unsigned{carcass.second} << '\n';
+   }
+   pathCache.write(oStream);
+   coarse.write(oStream);
+   // Last, since reading the creatures draws from it.
+   Creature::writeRNG(oStream);
+   oStream << '\n';
+}
+
+void World::readState(std::istream& iStream) {
+   TRACE_ZONE("World::readState");
+   const std::runtime_error invalid{"invalid world state"};
+   std::int64_t newLeft, newTop;
+   std::default_random_engine newRNG;
+   // Engines don't skip leading whitespace.
+   iStream >> currentStep >> newLeft >> newTop >> std::ws >> newRNG;
+   if (!iStream) throw invalid;
+   // Moving the cache mustn't convert creatures between the coarse populations and
+   // individuals, which draws from the engine; they're replaced anyway.
+   creatures.clear();
+   carcasses.clear();
+   coarse.clear();
+   if (newTop == std::numeric_limits<std::int64_t>::lowest()) {
+      // Nothing was cached; neither is anything now.
+      top = left = bottom = right = newTop;
+   } else {
+      updateTerrainCache(newLeft, newTop, 2 * terrainBlockSize - 1,
+                         2 * terrainBlockSize - 1);
+      if (left != newLeft || top != newTop) throw invalid;
+   }
+   rNG = newRNG;
+
+   const auto numTypes = Creature::getTypes().size();
+   std::size_t bucketCount, count;
+   iStream >> bucketCount >> count;
+   if (!iStream) throw invalid;
+   std::vector<CreatureInfo> newCreatureInfos;
+   newCreatureInfos.reserve(count);
+   for (std::size_t n = 0; n < count; ++n) {
+      Pos pos;
+      unsigned typeIndex, aiState, procreationOffset;
+      std::int16_t lifetime;
+      iStream >> pos[0] >> pos[1] >> typeIndex >> lifetime >> aiState >>
+          procreationOffset;
+      if (!iStream || typeIndex >= numTypes || aiState >= animalStates::SIZE) {
+         throw invalid;
+      }
+      newCreatureInfos.emplace_back(
+          pos, Creature{static_cast<std::uint8_t>(typeIndex), lifetime});
+      Creature& creature = newCreatureInfos.back().second;
+      creature.aiState = static_cast<std::uint16_t>(aiState);
+      creature.procreationOffset = static_cast<std::uint8_t>(procreationOffset);
+   }
+   // An element inserted into a hash map goes to the front of its bucket or, if that's
+   // empty, of the whole map (in libstdc++), so inserting the elements backwards
+   // restores their order.
+   decltype(creatures) newCreatures{bucketCount, PosHash{}, std::equal_to<Pos>{},
+                                    creatures.get_allocator()};
+   for (auto it = newCreatureInfos.rbegin(); it != newCreatureInfos.rend(); ++it) {
+      newCreatures.insert(*it);
+   }
+   creatures.swap(newCreatures);
+   forgetMissingFood();
+
+   iStream >> bucketCount >> count;
+   if (!iStream) throw invalid;
+   std::vector<std::pair<Pos, std::uint8_t>> newCarcassInfos;
+   newCarcassInfos.reserve(count);
+   for (std::size_t n = 0; n < count; ++n) {
+      Pos pos;
+      unsigned time;
+      iStream >> pos[0] >> pos[1] >> time;
+      if (!iStream) throw invalid;
+      newCarcassInfos.emplace_back(pos, static_cast<std::uint8_t>(time));
+   }
+   decltype(carcasses) newCarcasses{bucketCount, PosHash{}, std::equal_to<Pos>{},
+                                    carcasses.get_allocator()};
+   for (auto it = newCarcassInfos.rbegin(); it != newCarcassInfos.rend(); ++it) {
+      newCarcasses.insert(*it);
+   }
+   carcasses.swap(newCarcasses);
+
+   pathCache.read(iStream);
+   coarse.read(iStream);
+   Creature::readRNG(iStream);
+   if (!iStream) throw invalid;
+
+   // Food fields of a step with the same number would make this world diverge.
+   foodFieldSteps.fill(-1);
+   foodSourcesStep = -1;
+   zOrderStep = -1;
+}
+
+void World::setMemoryCap(std::size_t bytes) {
+   memoryCap = bytes;
+   pathCache.setMaxBytes(bytes == 0 ? pathCacheBytes
+                                    : std::min(pathCacheBytes, bytes / 8));
+}
+
+MemoryUsage World::getMemoryUsage() const {
+   MemoryUsage usage;
+   usage.creatures = creatureBytes;
+   usage.carcasses = carcassBytes;
+   usage.terrain = sizeof(terrainBlocks) + regions.bytesUsed();
+   usage.stepBuffers =
+       stepArena.bytesReserved() + changedPositions.capacity() * sizeof(Pos);
+   usage.pathCache = pathCache.bytesUsed();
+   usage.searches = gridSearch.bytesUsed() + pathHierarchy.bytesUsed() +
+                    movePath.capacity() * sizeof(Pos) +
+                    hierarchyCells.capacity() * sizeof(PathHierarchy::Cell) +
+                    foodCache.capacity() * sizeof(CreatureIt);
+   for (int n = 0; n < 2; ++n) {
+      usage.searches += (noFoodStamps[n].capacity() + foodBlockStamps[n].capacity()) *
+                        sizeof(std::uint32_t);
+   }
+   usage.searches += zOrderIndex.bytesUsed();
+   for (const auto& field : foodFields) usage.searches += field.bytesUsed();
+   for (const auto& sources : foodSources) {
+      usage.searches += sources.capacity() * sizeof(int);
+   }
+   // Nodes in use are counted by the containers they belong to.
+   usage.spareNodes = nodePool->bytesReserved() - nodePool->bytesInUse();
+   usage.coarse = coarse.bytesUsed();
+   return usage;
+}
+
+namespace {
+template <typename T, typename Allocator>
+void release(std::vector<T, Allocator>& v) {
+   v.clear();
+   v.shrink_to_fit();
+}
+}
+
+void World::enforceMemoryCap() {
+   const bool wasOver = overMemoryCap;
+   overMemoryCap = memoryCap != 0 && getMemoryUsage().total() > memoryCap;
+   if (overMemoryCap) {
+      TRACE_ZONE("World::enforceMemoryCap");
+      // Everything that's rebuilt or refilled on demand.  Nodes freed by the path cache
+      // stay in the pool, but new creatures can use them.
+      pathCache.clear();
+      release(offspringCache);
+      release(moveeCache);
+      stepArena.rewind(Arena::Mark{});
+      stepArena.release();
+      release(changedPositions);
+      gridSearch.release();
+      release(movePath);
+      release(hierarchyCells);
+      release(foodCache);
+      for (auto& stamps : noFoodStamps) release(stamps);
+      for (auto& blockStamps : foodBlockStamps) release(blockStamps);
+      foodFields.fill(FlowField{});
+      foodFieldSteps.fill(-1);
+      for (auto& sources : foodSources) release(sources);
+      foodSourcesStep = -1;
+      zOrderIndex.release();
+      zOrderStep = -1;
+      overMemoryCap = getMemoryUsage().total() > memoryCap;
+   }
+   if (overMemoryCap != wasOver) {
+      constexpr double mebibyte = 1024. * 1024.;
+      std::cerr << "warning: world uses " << std::fixed << std::setprecision(1)
+                << getMemoryUsage().total() / mebibyte << " MiB at step " << currentStep
+                << ", its cap is " << memoryCap / mebibyte << " MiB; "
+                << (overMemoryCap ? "not spawning creatures" : "spawning creatures again")
+                << std::endl;
+   }
+}
+
 void World::step() {
+   TRACE_ZONE("World::step");
    ++currentStep;
 #ifdef DEBUG  // {{{1
    std::cerr << "Step " << std::setfill('0') << std::setw(4) << currentStep << ": ";
 #endif  // }}}1
    changedPositions.clear();
+   rewindStepArena();
+   stats.beginStep(currentStep, Creature::getTypes().size());
+   enforceMemoryCap();
+   // With `CreatureStorage::zOrder`, the last commit left the index current.
+   if ((neighborLookup == NeighborLookup::zOrder ||
+        creatureStorage == CreatureStorage::zOrder) &&
+       zOrderStep != currentStep) {
+      rebuildZOrderIndex();
+   }
    for (auto it = creatures.begin(); it != creatures.end();) {
       const World::Pos& pos = it->first;
-      if (!isCached(pos)) {
-         ++it;
-         continue;
-      }
+      // Creatures that leave the cache join the coarse populations.
+      assert(isCached(pos));
       Creature& creature = it->second;
       if (creature.isPlant()) {
+         stats.setActor(creature.getTypeIndex(), Behavior::grow);
          updatePlant(*it);
       } else {
+         stats.setActor(creature.getTypeIndex(), Behavior::decide);
          updateAnimal(it);
       }
       if (creature.lifetime <= 0) {
+         stats.add(Counter::deaths);
          changedPositions.push_back(pos);
          if (creature.isPlant()) {
+            forgetCreature(*it);
             it = creatures.erase(it);
          } else {
             it = removeAnimal(it);
@@ -119,6 +369,9 @@ void World::step() {
          ++it;
       }
    }
+   stats.clearActor();
+   // Moves and offspring don't update it.
+   zOrderStep = -1;
 
    // Move animals and insert new plants and animals into the hash map.
    commitStep();
@@ -131,12 +384,33 @@ void World::step() {
          ++it;
       }
    }
+
+   if (currentStep % CoarsePopulations::interval == 0) coarse.step();
 #ifdef DEBUG  // {{{1
    std::cerr << creatures.size() << " denizens\n";
 #endif  // }}}1
 }
 
+void World::rewindStepArena() {
+   // Reserve what the last step needed, so the buffers rarely grow and leave their old
+   // copies in the arena.
+   const std::size_t numOffspring = offspringCache.capacity();
+   const std::size_t numMovees = moveeCache.capacity();
+   assert(offspringCache.empty() && moveeCache.empty());
+   // Their memory is about to be reused.
+   decltype(offspringCache){offspringCache.get_allocator()}.swap(offspringCache);
+   decltype(moveeCache){moveeCache.get_allocator()}.swap(moveeCache);
+   stepArena.rewind(Arena::Mark{});
+   offspringCache.reserve(numOffspring);
+   moveeCache.reserve(numMovees);
+}
+
 void World::commitStep() {
+   if (creatureStorage == CreatureStorage::zOrder) {
+      commitStepInZOrder();
+      return;
+   }
+   TRACE_ZONE("World::commitStep");
 // Really move animals.
 #ifdef DEBUG  // ... {{{1
    const auto bucketCount = creatures.bucket_count();
@@ -159,6 +433,7 @@ void World::commitStep() {
       creatures.erase(moveeInfo.second);
       creatures.emplace(pos, animal);
       assert(creatures.bucket_count() == bucketCount);
+      noteFoodArrival(pos, animal);
    }
    moveeCache.clear();
 
@@ -167,8 +442,52 @@ void World::commitStep() {
    for (auto& offspringInfo : offspringCache) {
       creatures.insert(offspringInfo);
       changedPositions.push_back(offspringInfo.first);
+      noteFoodArrival(offspringInfo.first, offspringInfo.second);
+   }
+   offspringCache.clear();
+}
+
+void World::commitStepInZOrder() {
+   TRACE_ZONE("World::commitStepInZOrder");
+   auto add = [this](const Pos& pos, const Creature& creature) {
+      zOrderIndex.add(static_cast<int>(pos[0] - left), static_cast<int>(pos[1] - top),
+                      creature);
+   };
+   const std::size_t count = creatures.size() + offspringCache.size();
+   // Moved animals go to their destination, and their nodes are marked so the pass over
+   // the hash map skips them.
+   zOrderIndex.clear(2 * terrainBlockSize);
+   for (auto& moveeInfo : moveeCache) {
+      const World::Pos& pos = moveeInfo.first;
+      Creature& animal = moveeInfo.second->second;
+      changedPositions.push_back(moveeInfo.second->first);
+      changedPositions.push_back(pos);
+      add(pos, animal);
+      noteFoodArrival(pos, animal);
+      animal.aiState = movedMark;
+   }
+   moveeCache.clear();
+   for (const auto& creatureInfo : creatures) {
+      if (creatureInfo.second.aiState != movedMark) {
+         add(creatureInfo.first, creatureInfo.second);
+      }
+   }
+   for (auto& offspringInfo : offspringCache) {
+      add(offspringInfo.first, offspringInfo.second);
+      changedPositions.push_back(offspringInfo.first);
+      noteFoodArrival(offspringInfo.first, offspringInfo.second);
    }
    offspringCache.clear();
+   zOrderIndex.sort();
+
+   // The nodes go back to the pool and are handed out again in Z-order.
+   creatures.clear();
+   creatures.reserve(count);
+   zOrderIndex.forEachCreature([this](int x, int y, const Creature& creature) {
+      creatures.emplace(Pos{left + x, top + y}, creature);
+   });
+   assert(creatures.size() == count);
+   zOrderStep = currentStep + 1;
 }
 
 void World::updatePlant(World::CreatureInfo& plantInfo) {
@@ -217,13 +536,31 @@ std::uint16_t World::getNewAnimalState(const World::CreatureInfo& animalInfo) {
       // `distanceToFood`.  A list of the found creatures is temporarily cached in
       // `foodCache`.
       int distanceToFood;
-      foodCache = findFood<10>(animalInfo, distanceToFood);
-      if (!foodCache.empty()) {
-         if (distanceToFood <= 1) {
+      if (foodSearch == FoodSearch::flowFields) {
+         // Look up the distance; only search for the food itself when it's in reach.  It
+         // may have been eaten earlier in this step.
+         const FlowField& field = getFoodField(animal.isHerbivore(), isLand(pos));
+         distanceToFood = field.getDistance(pos[0] - left, pos[1] - top);
+         foodCache.clear();
+         if (distanceToFood <= 1) findFood<1>(animalInfo, distanceToFood, foodCache);
+         if (!foodCache.empty()) {
             return animalStates::consume;
-         } else if (distanceToFood <= 10) {
+         } else if (1 < distanceToFood && distanceToFood <= 10) {
             return animalStates::hunt;
          }
+      } else if (isFoodMissing(animalInfo)) {
+         stats.add(Counter::skippedSearches);
+      } else {
+         findFood<maxFoodDist>(animalInfo, distanceToFood, foodCache);
+         if (!foodCache.empty()) {
+            if (distanceToFood <= 1) {
+               return animalStates::consume;
+            } else if (distanceToFood <= maxFoodDist) {
+               return animalStates::hunt;
+            }
+         } else {
+            rememberMissingFood(animalInfo);
+         }
       }
    }
    if (roaming && state != defaultRoamState) {
@@ -251,17 +588,25 @@ std::uint16_t World::getNewAnimalState(const World::CreatureInfo& animalInfo) {
 }
 
 void World::updateAnimal(World::CreatureIt animalIt) {
+   TRACE_ZONE("World::updateAnimal");
    Creature& animal = animalIt->second;
 
    auto& state = animal.aiState;
-   state = getNewAnimalState(*animalIt);
+   {
+      TRACE_ZONE("decide");
+      state = getNewAnimalState(*animalIt);
+   }
 
    // The first (numRoamStates - 1) states all indicate the animal is roaming.  The actual
    // value of aiState identifies the destination position relative to the animal's
    // current position.
    if (state < numRoamStates) {
+      TRACE_ZONE("roam");
+      stats.setBehavior(Behavior::roam);
       roam(animalIt);
    } else if (state == animalStates::procreate) {
+      TRACE_ZONE("procreate");
+      stats.setBehavior(Behavior::procreate);
       assert(animal.procreationOffset == 0);
       assert(animal.getRelativeLifetime() > 0.5);
       if (spawnOffspring(*animalIt)) {
@@ -270,10 +615,15 @@ void World::updateAnimal(World::CreatureIt animalIt) {
          assert(animal.procreationOffset == 0);
       }
    } else if (state == animalStates::hunt) {
+      TRACE_ZONE("hunt");
+      stats.setBehavior(Behavior::hunt);
       hunt(animalIt);
    } else if (state == animalStates::consume) {
+      TRACE_ZONE("consume");
+      stats.setBehavior(Behavior::consume);
       leech(animalIt);
    } else if (animalStates::rest <= state && state < animalStates::rest + 5) {
+      stats.setBehavior(Behavior::rest);
       animal.lifetime -= 5;
    } else {
       assert(false);
@@ -290,6 +640,7 @@ bool World::isCached(const World::Pos& pos) const { return isCached(pos[0], pos[
 
 void World::updateTerrainCache(std::int64_t left, std::int64_t top, std::int64_t width,
                                std::int64_t height) {
+   TRACE_ZONE("World::updateTerrainCache");
    std::int64_t right = left + width;
    std::int64_t bottom = top + height;
    if (isCached(left, top) && isCached(right, bottom)) {
@@ -302,6 +653,50 @@ void World::updateTerrainCache(std::int64_t left, std::int64_t top, std::int64_t
    std::int64_t i = std::lround(static_cast<float>(centerY) / terrainBlockSize) - 1;
    std::int64_t j = std::lround(static_cast<float>(centerX) / terrainBlockSize) - 1;
 
+   // The area of the Z-order index moves, and creatures leave and arrive.
+   zOrderStep = -1;
+   const bool wasCached = this->top != std::numeric_limits<std::int64_t>::lowest();
+   // The blocks (x, y) that were cached before, if any.
+   const std::int64_t oldI = this->top / terrainBlockSize;
+   const std::int64_t oldJ = this->left / terrainBlockSize;
+   auto isNew = [i, j](std::int64_t x, std::int64_t y) {
+      return i <= y && y < i + 2 && j <= x && x < j + 2;
+   };
+   if (wasCached) {
+      // Record the habitat of the blocks that leave the cache, then move their creatures
+      // there.  Creatures are only ever in the cache, so that's all creatures outside of
+      // the new one.
+      for (std::int64_t block = 0; block < 4; ++block) {
+         const Pos pos{oldJ + block % 2, oldI + block / 2};
+         if (isNew(pos[0], pos[1])) continue;
+         int numLandTiles = 0;
+         for (const auto& row : terrainBlocks[block]) {
+            for (TileType tileType : row) {
+               numLandTiles += toUT(tileType) >= toUT(TileType::sand);
+            }
+         }
+         coarse.addBlock(pos, terrainBlockSize * terrainBlockSize - numLandTiles,
+                         numLandTiles);
+      }
+      auto isLeaving = [&](const Pos& pos) {
+         return !isNew(floorDiv(pos[0], terrainBlockSize),
+                       floorDiv(pos[1], terrainBlockSize));
+      };
+      for (auto it = creatures.begin(); it != creatures.end();) {
+         if (isLeaving(it->first)) {
+            coarse.addCreature({floorDiv(it->first[0], terrainBlockSize),
+                                floorDiv(it->first[1], terrainBlockSize)},
+                               it->second.getTypeIndex());
+            it = creatures.erase(it);
+         } else {
+            ++it;
+         }
+      }
+      for (auto it = carcasses.begin(); it != carcasses.end();) {
+         it = isLeaving(it->first) ? carcasses.erase(it) : std::next(it);
+      }
+   }
+
    // Reuse blocks when possible.
    {
       // Mappings of which terrain blocks should be copies of another block instead of
@@ -313,7 +708,7 @@ void World::updateTerrainCache(std::int64_t left, std::int64_t top, std::int64_t
           {{2, 0}, {3, 1}, {0, 0}, {1, 1}},  // For scrolling up.
           {{2, 1}, {0, 0}, {1, 1}, {3, 3}},  // For scrolling up and right.
           {{1, 0}, {3, 2}, {0, 0}, {2, 2}},  // For scrolling left.
-          {{0, 0}, {1, 1}, {2, 2}, {3, 3}},  // This doesn't happen.
+          {{0, 0}, {1, 1}, {2, 2}, {3, 3}},  // For jumping; handled separately.
           {{0, 1}, {2, 3}, {1, 1}, {3, 3}},  // For scrolling right.
           {{1, 2}, {0, 0}, {2, 2}, {3, 3}},  // For scrolling down and left.
           {{0, 2}, {1, 3}, {2, 2}, {3, 3}},  // For scrolling down.
@@ -321,8 +716,6 @@ void World::updateTerrainCache(std::int64_t left, std::int64_t top, std::int64_t
       };
 
       // See how much the indices i and j changed.
-      auto oldI = this->top / terrainBlockSize;
-      auto oldJ = this->left / terrainBlockSize;
       auto deltaI = i - oldI;
       auto deltaJ = j - oldJ;
       assert(deltaI != 0 || deltaJ != 0);
@@ -337,25 +730,104 @@ void World::updateTerrainCache(std::int64_t left, std::int64_t top, std::int64_t
          // to directly move to a random position).
          direction = 4;
       }
-      for (const auto& mapping : reuse[direction]) {
-         auto dest = mapping[0];
-         auto source = mapping[1];
-         if (dest != source) {
-            // Copy a block.
-            terrainBlocks[dest] = terrainBlocks[source];
-         } else {
-            // Generate a block.
-            constexpr std::int64_t offsets[][2]{{0, 0}, {0, 1}, {1, 0}, {1, 1}};
-            auto& offset = offsets[dest];
-            terrainBlocks[dest] = mapGen.getBlock(i + offset[0], j + offset[1]);
+      if (direction == 4) {
+         // Nothing to reuse.  Generate all blocks at once, so the gradients along their
+         // shared edges are only computed once.
+         mapGen.getRegion(i, j, 2, 2, terrainBlocks.data());
+         for (std::size_t block = 0; block < 4; ++block) labelBlock(block);
+         stats.add(Counter::terrainBlocks, 4);
+      } else {
+         for (const auto& mapping : reuse[direction]) {
+            auto dest = mapping[0];
+            auto source = mapping[1];
+            if (dest != source) {
+               // Copy a block.
+               terrainBlocks[dest] = terrainBlocks[source];
+               regions.copyBlock(dest, source);
+            } else {
+               // Generate a block.
+               constexpr std::int64_t offsets[][2]{{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+               auto& offset = offsets[dest];
+               terrainBlocks[dest] = mapGen.getBlock(i + offset[0], j + offset[1]);
+               labelBlock(dest);
+               stats.add(Counter::terrainBlocks);
+            }
          }
       }
+      regions.connect();
    }
 
    this->top = i * terrainBlockSize;
    this->left = j * terrainBlockSize;
    this->bottom = this->top + 2 * terrainBlockSize;
    this->right = this->left + 2 * terrainBlockSize;
+
+   pathCache.clear();
+   forgetMissingFood();
+   pathHierarchy.setTerrain(2 * terrainBlockSize, 2 * terrainBlockSize,
+                            [this](int x, int y, bool onLand) {
+                               return getMovementCost({this->left + x, this->top + y},
+                                                      onLand);
+                            });
+
+   // Searches for the roaming destinations of the new animals need the regions.
+   for (std::size_t block = 0; block < 4; ++block) {
+      const std::int64_t x = j + block % 2, y = i + block / 2;
+      if (!wasCached || !(oldI <= y && y < oldI + 2 && oldJ <= x && x < oldJ + 2)) {
+         refineBlock(block);
+      }
+   }
+}
+
+void World::refineBlock(std::size_t index) {
+   const std::int64_t blockLeft = left + index % 2 * terrainBlockSize;
+   const std::int64_t blockTop = top + index / 2 * terrainBlockSize;
+   const std::vector<float> populations =
+       coarse.takeBlock({blockLeft / terrainBlockSize, blockTop / terrainBlockSize});
+   if (populations.empty()) return;
+   TRACE_ZONE("World::refineBlock");
+   // The tiles of the block by medium: water, land.
+   std::array<std::vector<Pos>, 2> tiles;
+   for (std::int64_t y = blockTop; y < blockTop + terrainBlockSize; ++y) {
+      for (std::int64_t x = blockLeft; x < blockLeft + terrainBlockSize; ++x) {
+         tiles[isLand(x, y)].push_back({x, y});
+      }
+   }
+   for (std::size_t type = 0; type < populations.size(); ++type) {
+      const auto typeIndex = static_cast<std::uint8_t>(type);
+      const SpeciesTraits& traits = Creature::getTypeTraits(typeIndex);
+      auto& habitat = tiles[traits.isTerrestrial()];
+      if (populations[type] == 0 || habitat.empty()) continue;
+      // Round randomly, so the expected number of creatures is kept.
+      const float whole = std::floor(populations[type]);
+      const auto count = static_cast<std::size_t>(whole) +
+                         (unitDist(rNG) < populations[type] - whole);
+      if (traits.isPlant()) {
+         // At most one plant per tile, like `spawnOffspring`: draw the tiles without
+         // replacement (a partial Fisher-Yates shuffle) and pass over vegetated ones.
+         std::size_t numPlaced = 0;
+         for (std::size_t n = 0; n < habitat.size() && numPlaced < count; ++n) {
+            std::uniform_int_distribution<std::size_t> tileDist{n, habitat.size() - 1};
+            std::swap(habitat[n], habitat[tileDist(rNG)]);
+            if (isVegetated(habitat[n])) continue;
+            creatures.emplace(habitat[n], Creature{typeIndex});
+            ++numPlaced;
+         }
+      } else {
+         std::uniform_int_distribution<std::size_t> tileDist{0, habitat.size() - 1};
+         for (std::size_t n = 0; n < count; ++n) {
+            auto it = creatures.emplace(habitat[tileDist(rNG)], Creature{typeIndex});
+            it->second.aiState = generateRoamState(*it);
+         }
+      }
+   }
+}
+
+void World::labelBlock(std::size_t index) {
+   const TerrainBlock& block = terrainBlocks[index];
+   regions.labelBlock(static_cast<int>(index), [&block](int row, int column) {
+      return toUT(block[row][column]) >= toUT(TileType::sand);
+   });
 }
 
 // Increasing x means going right, increasing y means going down.
@@ -398,11 +870,19 @@ bool World::isGoodPosition(const CreatureType& creatureType, std::int64_t x,
 
 int World::countCreatures(const World::Pos& pos, int radius,
                           std::uint8_t creatureTypeIndex) const {
+   if (neighborLookup == NeighborLookup::zOrder && zOrderStep == currentStep) {
+      const int x = static_cast<int>(pos[0] - left), y = static_cast<int>(pos[1] - top);
+      int numCells;
+      const int count = zOrderIndex.count(x, y, radius, creatureTypeIndex, numCells);
+      stats.add(Counter::countLookups, numCells);
+      return count;
+   }
    int count = 0;
    for (int xOffset = -radius; xOffset <= radius; ++xOffset) {
       int maxYOffset = radius - std::abs(xOffset);
       for (int yOffset = -maxYOffset; yOffset <= maxYOffset; ++yOffset) {
          assert(std::abs(xOffset) + std::abs(yOffset) <= radius);
+         stats.add(Counter::countLookups);
          auto range = creatures.equal_range({pos[0] + xOffset, pos[1] + yOffset});
          for (auto it = range.first; it != range.second; ++it) {
             if (it->second.getTypeIndex() == creatureTypeIndex) {
@@ -426,99 +906,164 @@ bool isHerbivore(World::CreatureIt creatureIt) {
 // conditions.  E.g., find food.
 // TODO: is there an elegant way to provide a `const` version of this function that
 // returns an `std::vector<decltype(creatures)::const_iterator`?
-// TODO: specialize for `maxDist == 0` and `maxDist == 1`?
 template <int maxDist, typename UnaryPredicate>
-std::vector<World::CreatureIt> World::getReachableCreatures(const World::Pos& start,
-                                                            UnaryPredicate pred,
-                                                            int& bestDist) {
-   std::vector<World::CreatureIt> matches;
-   auto range = creatures.equal_range(start);
-   for (auto it = range.first; it != range.second; ++it) {
-      if (pred(it)) {
-         matches.push_back(it);
+void World::getReachableCreatures(const World::Pos& start, UnaryPredicate pred,
+                                  int& bestDist,
+                                  std::vector<World::CreatureIt>& matches) {
+   matches.clear();
+   // Positions leave the queue in the order of their distance.  Once we found any match,
+   // we only look at the remaining positions at its distance and don't expand them,
+   // because we aren't interested in matches that are further away from `start`.
+   auto visit = [&](const World::Pos& pos, unsigned dist) {
+      if (!matches.empty() && static_cast<int>(dist) > bestDist) {
+         return GridSearch::Action::stop;
       }
-   }
-   if (!matches.empty()) {
-      bestDist = 0;
-      return matches;
-   }
-
-   bestDist = maxDist;
-
-   // This code is regrettably similar to but also curiously different from
-   // `World::getReachablePositions`.  TODO: DRY?
-   using PosDistPair = std::pair<World::Pos, int>;
-   std::queue<PosDistPair> frontier;
-   frontier.emplace(start, 0);
-   constexpr int diameter = 2 * maxDist + 1;
-   auto getIndex = [&](const World::Pos& pos) {
-      int i = pos[1] - start[1] + maxDist;
-      int j = pos[0] - start[0] + maxDist;
-      return diameter * i + j;
-   };
-   static bool visited[diameter * diameter];
-   std::fill_n(visited, diameter * diameter, false);
-   // Set the element corresponding to `start` to `true`;
-   visited[diameter * maxDist + maxDist] = true;
-   bool onLand = isLand(start);
-   while (!frontier.empty()) {
-      const World::Pos current = frontier.front().first;
-      int dist = frontier.front().second + 1;
-      // ...
-      if (dist > bestDist) break;
-      frontier.pop();
-      static constexpr World::Pos neighborOffsets[] = {{-1, 0}, {0, -1}, {0, 1}, {1, 0}};
-      for (const auto& offset : neighborOffsets) {
-         const World::Pos next{current[0] + offset[0], current[1] + offset[1]};
-         if (!isCached(next) || onLand != isLand(next)) {
-            continue;
-         }
-         bool& visitedNext = visited[getIndex(next)];
-         if (visitedNext) {
-            continue;
-         }
-         visitedNext = true;
-         auto range = creatures.equal_range(next);
-         for (auto it = range.first; it != range.second; ++it) {
-            if (pred(it)) {
-               // Gotcha.
-               matches.push_back(it);
-               bestDist = dist;
-            }
-         }
-         // We stop adding positions to `frontier` once we found any match, because we
-         // aren't interested in matches that are further away from `start` than others.
-         if (dist < bestDist) {
-            assert(matches.empty());
-            frontier.emplace(next, dist);
+      if (dist != 0) stats.add(Counter::bfsNodes);
+      auto range = creatures.equal_range(pos);
+      for (auto it = range.first; it != range.second; ++it) {
+         if (pred(it)) {
+            // Gotcha.
+            matches.push_back(it);
+            bestDist = dist;
          }
       }
-   }
-   return matches;
+      return matches.empty() ? GridSearch::Action::expand : GridSearch::Action::skip;
+   };
+   gridSearch.run<maxDist>(GridSearch::Window::around(getCacheWindow(), start, maxDist),
+                           start, GridSearch::UnitCost{},
+                           SameMedium{*this, isLand(start)}, visit,
+                           GridSearch::IgnoreReach{});
+   if (matches.empty()) bestDist = maxDist;
 }
 
 template <int maxDist>
-std::vector<World::CreatureIt> World::findFood(const World::CreatureInfo& animalInfo,
-                                               int& distanceToFood) {
+void World::findFood(const World::CreatureInfo& animalInfo, int& distanceToFood,
+                     std::vector<World::CreatureIt>& food) {
    const World::Pos& pos = animalInfo.first;
    const Creature& animal = animalInfo.second;
    assert(animal.isAnimal());
    if (animal.isHerbivore()) {
-      return getReachableCreatures<maxDist>(pos, &isPlant, distanceToFood);
+      getReachableCreatures<maxDist>(pos, &isPlant, distanceToFood, food);
    } else {
-      return getReachableCreatures<maxDist>(pos, &isHerbivore, distanceToFood);
+      getReachableCreatures<maxDist>(pos, &isHerbivore, distanceToFood, food);
    }
 }
 
-void World::spawnCreature(std::uint8_t typeIndex, std::int64_t x, std::int64_t y) {
+const FlowField& World::getFoodField(bool forHerbivores, bool onLand) {
+   const int index = 2 * forHerbivores + onLand;
+   FlowField& field = foodFields[index];
+   if (foodFieldSteps[index] == currentStep) return field;
+   TRACE_ZONE("World::getFoodField");
+   const int size = 2 * terrainBlockSize;
+   if (foodSourcesStep != currentStep) {
+      // One pass over all creatures collects the sources of all fields.
+      for (auto& sources : foodSources) sources.clear();
+      for (const auto& creatureInfo : creatures) {
+         const World::Pos& pos = creatureInfo.first;
+         const Creature& creature = creatureInfo.second;
+         if (!isCached(pos) || !(creature.isPlant() || creature.isHerbivore())) continue;
+         foodSources[2 * creature.isPlant() + isLand(pos)].push_back(
+             static_cast<int>(size * (pos[1] - top) + pos[0] - left));
+      }
+      foodSourcesStep = currentStep;
+   }
+   // Like `findFood<10>`, the search doesn't cross between land and water.
+   stats.add(Counter::bfsNodes,
+             field.compute(size, size, foodSources[index], 10, [&](int x, int y) {
+                return isLand(left + x, top + y) == onLand;
+             }));
+   foodFieldSteps[index] = currentStep;
+   return field;
+}
+
+bool World::isFoodMissing(const World::CreatureInfo& animalInfo) const {
+   const World::Pos& pos = animalInfo.first;
+   const bool forHerbivores = animalInfo.second.isHerbivore();
+   const std::vector<std::uint32_t>& stamps = noFoodStamps[forHerbivores];
+   if (stamps.empty()) return false;
+   const int size = 2 * terrainBlockSize;
+   const std::uint32_t stamp = stamps[size * (pos[1] - top) + pos[0] - left];
+   if (stamp == 0) return false;
+   // All blocks with a tile within `maxFoodDist` of `pos` in both axes.
+   const int numColumns = size / foodBlockSize;
+   const auto minColumn = (std::max(pos[0] - maxFoodDist, left) - left) / foodBlockSize;
+   const auto maxColumn =
+       (std::min(pos[0] + maxFoodDist, right - 1) - left) / foodBlockSize;
+   const auto minRow = (std::max(pos[1] - maxFoodDist, top) - top) / foodBlockSize;
+   const auto maxRow = (std::min(pos[1] + maxFoodDist, bottom - 1) - top) / foodBlockSize;
+   const std::vector<std::uint32_t>& blockStamps = foodBlockStamps[forHerbivores];
+   for (auto row = minRow; row <= maxRow; ++row) {
+      for (auto column = minColumn; column <= maxColumn; ++column) {
+         if (blockStamps[numColumns * row + column] > stamp) return false;
+      }
+   }
+   return true;
+}
+
+void World::rememberMissingFood(const World::CreatureInfo& animalInfo) {
+   const int size = 2 * terrainBlockSize;
+   if (noFoodStamps[0].empty()) {
+      const int numBlocks = (size / foodBlockSize) * (size / foodBlockSize);
+      for (auto& stamps : noFoodStamps) stamps.assign(size * size, 0);
+      for (auto& blockStamps : foodBlockStamps) blockStamps.assign(numBlocks, 0);
+   }
+   const World::Pos& pos = animalInfo.first;
+   noFoodStamps[animalInfo.second.isHerbivore()][size * (pos[1] - top) + pos[0] - left] =
+       foodClock;
+}
+
+void World::noteFoodArrival(const World::Pos& pos, const Creature& creature) {
+   if (!(creature.isPlant() || creature.isHerbivore())) return;
+   std::vector<std::uint32_t>& blockStamps = foodBlockStamps[creature.isPlant()];
+   if (blockStamps.empty()) return;
+   if (++foodClock == 0) {
+      // The clock wrapped around; stamps can't be compared anymore.
+      forgetMissingFood();
+      return;
+   }
+   const int numColumns = 2 * terrainBlockSize / foodBlockSize;
+   blockStamps[numColumns * ((pos[1] - top) / foodBlockSize) +
+               (pos[0] - left) / foodBlockSize] = foodClock;
+}
+
+void World::forgetMissingFood() {
+   for (auto& stamps : noFoodStamps) stamps.clear();
+   for (auto& blockStamps : foodBlockStamps) blockStamps.clear();
+   foodClock = 1;
+}
+
+bool World::spawnCreature(std::uint8_t typeIndex, std::int64_t x, std::int64_t y) {
    // Assert we don't try to place a creature on a hostile tile (e.g. a fish on land).
    assert(isGoodPosition(Creature::getTypes()[typeIndex], {x, y}));
+   if (overMemoryCap) {
+      stats.add(Counter::refusedSpawns);
+      return false;
+   }
    auto it = creatures.emplace(Pos{x, y}, Creature{typeIndex});
    it->second.aiState = generateRoamState(*it);
+   noteFoodArrival(it->first, it->second);
+   zOrderStep = -1;
+   return true;
+}
+
+void World::spawnCreatures(const std::vector<World::CreatureInfo>& newCreatures) {
+   creatures.reserve(creatures.size() + newCreatures.size());
+   for (const auto& creatureInfo : newCreatures) {
+      assert(isCached(creatureInfo.first));
+      assert(isGoodPosition(creatureInfo.second.getType(), creatureInfo.first));
+      auto it = creatures.insert(creatureInfo);
+      if (it->second.isAnimal()) it->second.aiState = generateRoamState(*it);
+      noteFoodArrival(it->first, it->second);
+   }
+   zOrderStep = -1;
 }
 
 bool World::spawnOffspring(World::CreatureInfo& parentInfo) {
-   static std::uniform_int_distribution<int> rNDist{-5, 5};
+   if (overMemoryCap) {
+      stats.add(Counter::refusedSpawns);
+      return false;
+   }
+   std::uniform_int_distribution<int> rNDist{-5, 5};
    const World::Pos& pos = parentInfo.first;
    Creature& parent = parentInfo.second;
    const CreatureType& creatureType = parent.getType();
@@ -543,14 +1088,13 @@ bool World::spawnOffspring(World::CreatureInfo& parentInfo) {
          return false;
       }
       offspringCache.push_back(CreatureInfo{childPos, Creature{parent.getTypeIndex()}});
+      stats.add(Counter::births);
       return true;
    } else {
-      // Get all positions the parent can reach without moving a distance greater than 3.
-      std::vector<World::Pos> positions = getReachablePositions(pos, 3);
-      if (positions.size() == 1) return false;  // There's no space.
-      assert(positions[0] == pos);
-      // Pick a random position other than the one of the parent.
-      World::Pos childPos = positions[1 + defaultRNDist(rNG) % (positions.size() - 1)];
+      // Pick a random position other than the one of the parent that it can reach without
+      // moving a distance greater than 3.
+      World::Pos childPos = sampleReachablePosition(pos, 3, false);
+      if (childPos == pos) return false;  // There's no space.
       assert(isGoodPosition(creatureType, childPos));
       std::int16_t childLifetime = std::lround(0.5 * parent.lifetime);
       offspringCache.push_back(
@@ -558,6 +1102,7 @@ bool World::spawnOffspring(World::CreatureInfo& parentInfo) {
       parent.lifetime = std::lround(0.75 * parent.lifetime);
       // Reset the timer specifying when the animal can reproduce again.
       parent.procreationOffset = parent.getProcreationInterval() - 1;
+      stats.add(Counter::births);
       return true;
    }
 }
@@ -574,8 +1119,10 @@ void World::leech(World::CreatureIt actorIt, World::CreatureIt targetIt) {
    assert(actor.lifetime <= actor.getMaxLifetime());
    target.lifetime -= amount;
    if (target.lifetime <= 0) {
+      stats.add(target.getTypeIndex(), Behavior::none, Counter::deaths);
       changedPositions.push_back(targetIt->first);
       if (target.isPlant()) {
+         forgetCreature(*targetIt);
          creatures.erase(targetIt);
       } else {
          removeAnimal(targetIt);
@@ -608,8 +1155,7 @@ std::uint16_t World::generateRoamState(const World::CreatureInfo& animalInfo) co
    const World::Pos& pos = animalInfo.first;
    // TODO: exclude the animal's current positions from the candidates?  What if that's
    // the only candidate?  It is the only one that is guaranteed.
-   std::vector<World::Pos> positions = getReachablePositions(pos, 10);
-   const World::Pos dest = positions[defaultRNDist(rNG) % positions.size()];
+   const World::Pos dest = sampleReachablePosition(pos, 10, true);
    assert(isCached(dest));
    // The path includes the current position.
    assert(getPath(pos, dest).size() <= maxRoamDist + 1);
@@ -639,6 +1185,11 @@ void World::roam(World::CreatureIt animalIt) {
 
 void World::hunt(World::CreatureIt animalIt) {
    assert(animalIt->second.isAnimal());
+   if (foodSearch == FoodSearch::flowFields) {
+      moveAlong(animalIt,
+                getFoodField(animalIt->second.isHerbivore(), isLand(animalIt->first)));
+      return;
+   }
    assert(!foodCache.empty());
    // Pick a random creature.
    World::CreatureIt targetIt;
@@ -652,151 +1203,166 @@ void World::hunt(World::CreatureIt animalIt) {
    moveTowards(animalIt, dest, true);
 }
 
+std::vector<World::Pos> World::getPath(World::Pos start, World::Pos dest) const {
+   std::vector<World::Pos> path;
+   getPath(start, dest, path);
+   return path;
+}
+
+void World::getPath(World::Pos start, World::Pos dest,
+                    std::vector<World::Pos>& path) const {
+   const unsigned region = getRegion(start);
+   if (getRegion(dest) != region) {
+      // Rather than exhausting the start's region in search of `dest`, head for the
+      // position closest to it that can be reached.
+      stats.add(Counter::unreachablePaths);
+      dest = getClosestInRegion(dest, region);
+   }
+   if (pathCache.find(start, dest, path)) {
+      stats.add(Counter::pathCacheHits);
+      return;
+   }
+   if (distance(start, dest) > PathHierarchy::clusterSize) {
+      getHierarchicalPath(start, dest, path);
+   } else {
+      getTilePath(start, dest, path);
+   }
+   // Paths of a single step are cheaper to plan again than to look up.  Paths that don't
+   // reach `dest` wouldn't help queries from other positions on them.
+   if (path.size() > 2 && path.front() == dest) pathCache.insert(path);
+}
+
+World::Pos World::getClosestInRegion(const World::Pos& pos, unsigned region) const {
+   // Search rings of increasing distance around `pos`.
+   const std::int64_t maxDist = (right - left) + (bottom - top);
+   for (std::int64_t dist = 0; dist <= maxDist; ++dist) {
+      for (std::int64_t dx = -dist; dx <= dist; ++dx) {
+         const std::int64_t dy = dist - std::abs(dx);
+         for (const std::int64_t y : {pos[1] - dy, pos[1] + dy}) {
+            const World::Pos candidate{pos[0] + dx, y};
+            if (isCached(candidate) && getRegion(candidate) == region) return candidate;
+         }
+      }
+   }
+   assert(false);  // Every region has a position.
+   return pos;
+}
+
+void World::getHierarchicalPath(World::Pos start, World::Pos dest,
+                                std::vector<World::Pos>& path) const {
+   TRACE_ZONE("World::getHierarchicalPath");
+   assert(isCached(start));
+   assert(isCached(dest));
+   stats.add(Counter::pathCalls);
+   const auto work = pathHierarchy.findPath(
+       {static_cast<int>(start[0] - left), static_cast<int>(start[1] - top)},
+       {static_cast<int>(dest[0] - left), static_cast<int>(dest[1] - top)}, isLand(start),
+       hierarchyCells);
+   stats.add(Counter::pathNodes, work.nodes);
+   stats.add(Counter::pathClusters, work.clusters);
+   path.clear();
+   for (const auto& cell : hierarchyCells) {
+      path.push_back({left + cell[0], top + cell[1]});
+   }
+}
+
 // Compute the shortest path from `start` to `dest` using the A* algorithm.  Based on
 // [this introduction][1].  TODO: based on the demos, I think the linked page uses the
 // estimated distance to the destination as a tiebreaker when multiple positions have the
 // same priority; maybe implement that optimization.
 // [1]: http://redblobgames.com/pathfinding/a-star/introduction.html
-std::vector<World::Pos> World::getPath(World::Pos start, World::Pos dest) const {
+void World::getTilePath(World::Pos start, World::Pos dest,
+                        std::vector<World::Pos>& path) const {
+   TRACE_ZONE("World::getTilePath");
    assert(isCached(start));
    assert(isCached(dest));
-   using P3 = std::pair<int, World::Pos>;  // Priority-position pair.
-   struct P3Compare {
-      constexpr bool operator()(const P3& lhs, const P3& rhs) const {
-         return lhs.first > rhs.first;
-      }
-   };
-   // The element with the smallest priority is returned by frontier.top() and removed
-   // with frontier.pop().
-   std::priority_queue<P3, std::vector<P3>, P3Compare> frontier;
-   frontier.emplace(0, start);
-
-   // Extra information saved for positions we visited: the previous position based on the
-   // best known path and the resulting total cost.
-   struct PosInfo {
-      World::Pos previous;
-      unsigned cost;
-   };
-   // TODO: maybe use an array.
-   std::unordered_map<World::Pos, PosInfo, World::PosHash> posInfoMap{
-       {start, PosInfo{{0, 0}, 0}}};
+   stats.add(Counter::pathCalls);
 
    // When `dest` can't be reached, we return the fastest path to the closest reachable
    // position.
    World::Pos closest = start;
    auto bestDistance = distance(start, dest);
-
-   bool onLand = isLand(start);
-
-   World::Pos current;
-   while (!frontier.empty()) {
-      current = frontier.top().second;
-      frontier.pop();
-      if (current == dest) {
-         break;
-      }
-      static constexpr World::Pos neighborOffsets[] = {{-1, 0}, {0, -1}, {0, 1}, {1, 0}};
-      for (const auto& offset : neighborOffsets) {
-         World::Pos next{current[0] + offset[0], current[1] + offset[1]};
-         // Only look at the cached part of the map.  XXX: this means the path will depend
-         // on which part of the map is cached in some cases.
-         if (!isCached(next[0], next[1])) {
-            continue;
-         }
-         int tileCost = getMovementCost(next, onLand);
-         if (tileCost < 0) {
-            continue;
-         }
-         unsigned nextCost = posInfoMap[current].cost + tileCost;
-         auto it = posInfoMap.find(next);
-         if (it != posInfoMap.end()) {
-            // We already visited this position.
-            const PosInfo& nextInfo = it->second;
-            if (nextCost >= nextInfo.cost) {
-               // We already have a path to `next` that's just as fast or faster.
-               continue;
-            }
-         }
-         // This is the best path to `next` so far.
-         auto newDistance = distance(next, dest);
-         frontier.emplace(nextCost + newDistance, next);
-         posInfoMap[next] = PosInfo{current, nextCost};
-         if (newDistance < bestDistance) {
-            closest = next;
-            bestDistance = newDistance;
-         }
+   bool isFound = false;
+   auto visit = [&](const World::Pos& pos, unsigned) {
+      stats.add(Counter::pathNodes);
+      isFound = pos == dest;
+      return isFound ? GridSearch::Action::stop : GridSearch::Action::expand;
+   };
+   auto reach = [&](const World::Pos& pos, unsigned) {
+      auto newDistance = distance(pos, dest);
+      if (newDistance < bestDistance) {
+         closest = pos;
+         bestDistance = newDistance;
       }
-   }
-
-   if (current != dest) {
-      current = closest;
-   }
+   };
+   // Only look at the cached part of the map.  XXX: this means the path will depend on
+   // which part of the map is cached in some cases.
+   gridSearch.run<GridSearch::unbounded>(getCacheWindow(), start,
+                                         MovementCost{*this, isLand(start), dest},
+                                         GridSearch::AnyTile{}, visit, reach);
 
    // Construct the path by going backwards from the destination (or the closest position
    // to the destination).  XXX: the vector we return is reversed.
-   std::vector<World::Pos> path;
-   path.push_back(current);
-   while (current != start) {
-      current = posInfoMap[current].previous;
-      path.push_back(current);
-   }
-   return path;
+   gridSearch.getPath(isFound ? dest : closest, path);
+}
+
+GridSearch::Window World::getCacheWindow() const {
+   return {{{left, top}}, static_cast<int>(right - left), static_cast<int>(bottom - top)};
+}
+
+// Breadth-first search from `start`, calling `visit` for every position (other than
+// `start`) that can be reached without moving a distance greater than `maxDist`.
+template <typename Visitor>
+void World::forEachReachablePosition(const World::Pos& start, int maxDist,
+                                     Visitor visit) const {
+   auto visitReached = [&](const World::Pos& pos, unsigned dist) {
+      if (dist != 0) {
+         stats.add(Counter::bfsNodes);
+         visit(pos);
+      }
+      return GridSearch::Action::expand;
+   };
+   gridSearch.run<GridSearch::dynamicRadius>(
+       GridSearch::Window::around(getCacheWindow(), start, maxDist), start,
+       GridSearch::UnitCost{}, SameMedium{*this, isLand(start)}, visitReached,
+       GridSearch::IgnoreReach{}, maxDist);
 }
 
 std::vector<World::Pos> World::getReachablePositions(const World::Pos& start,
                                                      int maxDist) const {
    std::vector<World::Pos> positions{start};
-   using PosDistPair = std::pair<World::Pos, int>;
-   std::queue<PosDistPair> frontier;
-   frontier.emplace(start, 0);
-   // Diameter of the square containing all positions that are potentially reachable
-   // without moving a distance greater than `maxDist`.
-   const int diameter = 2 * maxDist + 1;
    // This should be the absolute maximum number of elements we may need.
-   positions.reserve(diameter * diameter - 1);
-   auto getIndex = [&](const World::Pos& pos) {
-      int i = pos[1] - start[1] + maxDist;
-      int j = pos[0] - start[0] + maxDist;
-      assert(0 <= i && i < diameter);
-      assert(0 <= j && j < diameter);
-      return diameter * i + j;
-   };
-   std::unique_ptr<bool[]> visited(new bool[diameter * diameter]);
-   // Initialize the array by setting all elements to `false`.
-   std::fill_n(visited.get(), diameter * diameter, false);
-   // Set the element corresponding to `start` to `true`;
-   visited[diameter * maxDist + maxDist] = true;
-   bool onLand = isLand(start);
-   while (!frontier.empty()) {
-      const World::Pos current = frontier.front().first;
-      int dist = frontier.front().second + 1;
-      assert(dist <= maxDist);
-      frontier.pop();
-      static constexpr World::Pos neighborOffsets[] = {{-1, 0}, {0, -1}, {0, 1}, {1, 0}};
-      for (const auto& offset : neighborOffsets) {
-         const World::Pos next{current[0] + offset[0], current[1] + offset[1]};
-         if (!isCached(next) || onLand != isLand(next)) {
-            continue;
-         }
-         assert(distance(current, next) == 1);
-         assert(visited[getIndex(current)]);
-         assert(distance(start, next) <= maxDist);
-         bool& visitedNext = visited[getIndex(next)];
-         if (visitedNext) {
-            continue;
-         }
-         assert(distance(start, next) <= dist);  // We can't get a path that's shorter
-                                                 // than the Manhattan distance.
-         visitedNext = true;
-         positions.push_back(next);
-         if (dist != maxDist) {
-            frontier.emplace(next, dist);
-         }
-      }
-   }
+   positions.reserve((2 * maxDist + 1) * (2 * maxDist + 1));
+   forEachReachablePosition(start, maxDist,
+                            [&](const World::Pos& pos) { positions.push_back(pos); });
    return positions;
 }
 
+// Reservoir sampling with a reservoir of one: the n-th position replaces the sample with
+// probability 1/n.  Instead of drawing a random number for every position, the number of
+// positions to skip until the next replacement is drawn (Li's "Algorithm L"), so only
+// O(log n) random numbers are needed.
+World::Pos World::sampleReachablePosition(const World::Pos& start, int maxDist,
+                                          bool includeStart) const {
+   auto getUnit = [this] { return 1. - unitDist(rNG); };  // (0, 1]
+   World::Pos sample = start;
+   std::size_t count = 0;  // Positions seen so far.
+   std::size_t nextPick = 0;
+   // The first position is always picked, which makes `w` a single uniform number.
+   double w = 1.;
+   auto offer = [&](const World::Pos& pos) {
+      if (count++ != nextPick) return;
+      sample = pos;
+      w *= getUnit();
+      const double skip = std::floor(std::log(getUnit()) / std::log1p(-w));
+      // `skip` may be huge or infinite once `w` gets tiny.
+      nextPick = skip < 1e9 ? count + static_cast<std::size_t>(skip) : SIZE_MAX;
+   };
+   if (includeStart) offer(start);
+   forEachReachablePosition(start, maxDist, offer);
+   return sample;
+}
+
 World::Pos World::moveTowards(World::CreatureIt animalIt, const World::Pos& dest,
                               bool run) {
    assert(animalIt != creatures.end());
@@ -805,7 +1371,8 @@ World::Pos World::moveTowards(World::CreatureIt animalIt, const World::Pos& dest
    assert(isGoodPosition(animal.getType(), dest));
    std::size_t range = run ? animal.getRunSpeed() : animal.getWalkSpeed();
    assert(distance(pos, dest) <= maxRoamDist);
-   const std::vector<Pos> path = getPath(pos, dest);
+   getPath(pos, dest, movePath);
+   const std::vector<Pos>& path = movePath;
    // The path includes the current position.
    auto distanceMoved = std::min(range, path.size() - 1);
    assert(distanceMoved <= maxRoamDist);
@@ -815,11 +1382,30 @@ World::Pos World::moveTowards(World::CreatureIt animalIt, const World::Pos& dest
       animal.lifetime -= 2 * distanceMoved;
    }
    World::Pos newPos = *(path.rbegin() + distanceMoved);
+   if (distanceMoved > 0) stats.add(Counter::moves);
    assert(distance(newPos, dest) <= maxRoamDist);
    moveeCache.push_back(std::make_pair(newPos, animalIt));
    return newPos;
 }
 
+World::Pos World::moveAlong(World::CreatureIt animalIt, const FlowField& field) {
+   const World::Pos& pos = animalIt->first;
+   Creature& animal = animalIt->second;
+   const int size = 2 * terrainBlockSize;
+   const std::size_t range = animal.getRunSpeed();
+   World::Pos newPos = pos;
+   std::size_t distanceMoved = 0;
+   for (; distanceMoved < range; ++distanceMoved) {
+      const int next = field.getNextCell(newPos[0] - left, newPos[1] - top);
+      if (next < 0) break;  // Arrived, or the field is stale.
+      newPos = World::Pos{left + next % size, top + next / size};
+   }
+   animal.lifetime -= 10 * distanceMoved;
+   if (distanceMoved > 0) stats.add(Counter::moves);
+   moveeCache.push_back(std::make_pair(newPos, animalIt));
+   return newPos;
+}
+
 World::CreatureIt World::removeAnimal(World::CreatureIt animalIt) {
    assert(animalIt->second.isAnimal());
    // FIXME: inefficient.
@@ -831,9 +1417,29 @@ World::CreatureIt World::removeAnimal(World::CreatureIt animalIt) {
       }
    }
    carcasses[animalIt->first] = 10;  // Display the carcass graphic for 10 steps.
+   forgetCreature(*animalIt);
    return creatures.erase(animalIt);
 }
 
+void World::forgetCreature(const World::CreatureInfo& creatureInfo) {
+   if (zOrderStep != currentStep) return;
+   const Pos& pos = creatureInfo.first;
+   zOrderIndex.remove(static_cast<int>(pos[0] - left), static_cast<int>(pos[1] - top),
+                      creatureInfo.second.getTypeIndex());
+}
+
+void World::rebuildZOrderIndex() {
+   TRACE_ZONE("World::rebuildZOrderIndex");
+   zOrderIndex.clear(2 * terrainBlockSize);
+   for (const auto& creatureInfo : creatures) {
+      const Pos& pos = creatureInfo.first;
+      zOrderIndex.add(static_cast<int>(pos[0] - left), static_cast<int>(pos[1] - top),
+                      creatureInfo.second);
+   }
+   zOrderIndex.sort();
+   zOrderStep = currentStep;
+}
+
 // Map a signed integer number z to the interval [0, 2^n - 1].  Injective for the domain
 // [- 2^(n-1), 2^(n-1) - 1].
 template <std::size_t n, typename Z>
@@ -4,35 +4,168 @@
 #include <array>          // array
 #include <cstddef>        // size_t
 #include <cstdint>        // int64_t, uint8_t
+#include <functional>     // equal_to
+#include <iosfwd>         // istream, ostream
 #include <limits>         // numeric_limits
+#include <memory>         // shared_ptr, make_shared
+#include <random>         // default_random_engine, random_device
 #include <unordered_map>  // unordered_multimap, unordered_map
 #include <utility>        // std::pair
 #include <vector>         // vector
 
+#include "coarse_populations.hpp"
 #include "creature.hpp"
 #include "creature_type.hpp"
+#include "flow_field.hpp"
+#include "grid_search.hpp"
 #include "map_generator.hpp"
+#include "path_cache.hpp"
+#include "path_hierarchy.hpp"
+#include "pool_allocator.hpp"
+#include "region_labels.hpp"
+#include "step_stats.hpp"
 #include "tile_type.hpp"
+#include "z_order_index.hpp"
+
+// How hungry animals find food.
+enum class FoodSearch : std::uint8_t {
+   // Every animal searches its surroundings and plans its path on its own.
+   perAnimal,
+   // Once per step, the distance to the closest food is computed for every tile, and
+   // animals follow it.  Food eaten during a step keeps attracting animals until the next
+   // one, and paths ignore the terrain's movement costs.
+   flowFields
+};
+
+// How `World::countCreatures` finds the creatures around a position.  Both give the same
+// counts.
+enum class NeighborLookup : std::uint8_t {
+   // Look up every position within the radius in the hash map of creatures.
+   hashMap,
+   // Scan the cells of a copy of the creatures sorted in Z-order, which is rebuilt at the
+   // start of each step.
+   zOrder
+};
+
+// How `World::commitStep` stores the creatures for the next step.  The hash map is
+// iterated in a different order afterwards, so the two make a world evolve differently.
+enum class CreatureStorage : std::uint8_t {
+   // Move animals and insert offspring in the hash map one at a time.
+   hashMap,
+   // Copy the creatures, moved animals and offspring into one array in a single pass,
+   // sort it in Z-order with a radix sort, and rebuild the hash map from it in that
+   // order.  The array serves as the Z-order index of the next step.
+   zOrder
+};
+
+// The memory a world uses, in bytes, by what it's used for.  Hash maps count their nodes
+// and buckets; vectors their capacity.
+struct MemoryUsage {
+   std::size_t creatures = 0;
+   std::size_t carcasses = 0;
+   std::size_t terrain = 0;      // The cached blocks and their regions.
+   std::size_t stepBuffers = 0;  // Offspring, movees, and changed positions of a step.
+   std::size_t pathCache = 0;
+   // Scratch space, the path hierarchy, food fields, the Z-order index.
+   std::size_t searches = 0;
+   std::size_t spareNodes = 0;   // Kept by the `NodePool` for future nodes.
+   std::size_t coarse = 0;       // The populations outside the cached terrain.
+
+   std::size_t total() const {
+      return creatures + carcasses + terrain + stepBuffers + pathCache + searches +
+             spareNodes + coarse;
+   }
+};
 
 class World {
   public:
    using Pos = std::array<std::int64_t, 2>;
    using CreatureInfo = std::pair<const Pos, Creature>;
 
+   using SeedType = std::default_random_engine::result_type;
+
+   // Use random seeds.
+   World();
+   // Use a fixed seed for generating terrain.
+   explicit World(MapGenerator::SeedType mapSeed);
+   // Also fix the seed of all random decisions of the simulation.  Two worlds with the
+   // same seeds that are stepped and modified the same way evolve identically, as long as
+   // they're the only worlds on their threads that create creatures.  Seeds the creature
+   // engine of the calling thread (see `Creature::seedRNG`).
+   World(MapGenerator::SeedType mapSeed, SeedType seed);
+   // The allocators of the hash maps keep pointers to `creatureBytes` and `carcassBytes`.
+   World(const World&) = delete;
+   World(World&&) = delete;
+   World& operator=(const World&) = delete;
+   World& operator=(World&&) = delete;
+
    struct PosHash {
       std::size_t operator()(const Pos& pos) const;
    };
 
-   std::unordered_multimap<Pos, Creature, PosHash> creatures;
+  private:
+   // Provides the nodes of `creatures` and `carcasses`.  Moving an animal erases and
+   // reinserts its node, so most steps allocate and free lots of them.  Declared before
+   // the containers, because members are initialized in the order of their declaration.
+   std::shared_ptr<NodePool> nodePool = std::make_shared<NodePool>();
+   // Counted by the allocators of `creatures` and `carcasses`.
+   std::size_t creatureBytes = 0;
+   std::size_t carcassBytes = 0;
+
+  public:
+   // The creatures of the cached terrain.  Only those are simulated individually; see
+   // `updateTerrainCache`.
+   std::unordered_multimap<Pos, Creature, PosHash, std::equal_to<Pos>,
+                           PoolAllocator<CreatureInfo>>
+       creatures{0, PosHash{}, std::equal_to<Pos>{},
+                 PoolAllocator<CreatureInfo>{nodePool, &creatureBytes}};
 
    using CreatureIt = decltype(creatures)::iterator;
 
    // Saves the time until the carcass should disappear.
-   std::unordered_map<Pos, std::uint8_t, PosHash> carcasses;
+   std::unordered_map<Pos, std::uint8_t, PosHash, std::equal_to<Pos>,
+                      PoolAllocator<std::pair<const Pos, std::uint8_t>>>
+       carcasses{0, PosHash{}, std::equal_to<Pos>{},
+                 PoolAllocator<std::pair<const Pos, std::uint8_t>>{nodePool,
+                                                                   &carcassBytes}};
 
    // Specifies positions the GUI should repaint.  Cleared at the start of each step.
    std::vector<Pos> changedPositions;
 
+   // Counters of the most recent steps.  Mutable, because `const` searches also count the
+   // work they do.  Work done between two steps (e.g. generating terrain when the user
+   // scrolls) is counted towards the preceding step.
+   mutable StepStats stats;
+
+   SeedType getSeed() const { return seed; }
+   // The number of steps so far.
+   int getCurrentStep() const { return currentStep; }
+
+   // Write everything that decides how the world evolves, including the cached paths, but
+   // except the seed of the terrain and the settings (`FoodSearch`, `CreatureStorage`,
+   // the capacity of the path cache and the memory cap), as text.  Leaves the world as
+   // it is.  Has to be called between steps on the thread that steps the world.
+   void writeState(std::ostream&) const;
+   // Replace the state with one written by a world with the same map seed and settings.
+   // The rebuilt hash maps iterate in the writer's order, so this world continues exactly
+   // like the writer.  Throws `std::runtime_error` if the state can't be parsed.
+   void readState(std::istream&);
+
+   MemoryUsage getMemoryUsage() const;
+
+   // Keep the memory use below `bytes`; 0 (the default) means no limit.  It's a soft cap:
+   // at the start of each step, a world above it frees the memory it can spare (the path
+   // cache, buffers, and scratch space).  While that doesn't suffice, no offspring and
+   // no creatures are spawned, which a warning on `std::cerr` announces.  Animals keep
+   // trying to procreate.  How much memory buffers hold depends on more than the state
+   // saved by `writeState`, so runs that reach the cap may not replay exactly.  The path
+   // cache gets a budget of an eighth of the cap (or `pathCacheBytes`, if less), which it
+   // keeps while inserting.
+   void setMemoryCap(std::size_t bytes);
+   std::size_t getMemoryCap() const { return memoryCap; }
+   // Was the memory use above the cap at the start of the current step?
+   bool isOverMemoryCap() const { return overMemoryCap; }
+
    void step();
    void commitStep();
    void updatePlant(CreatureInfo&);
@@ -42,9 +175,19 @@ class World {
    bool isCached(std::int64_t x, std::int64_t y) const;
    bool isCached(const Pos&) const;
 
+   // Cache the terrain of the given area.  The creatures of blocks that leave the cache
+   // join the coarse populations of their blocks, and the blocks that enter it are
+   // populated at random from theirs.  Carcasses that leave the cache disappear.
    void updateTerrainCache(std::int64_t left, std::int64_t top, std::int64_t width,
                            std::int64_t height);
 
+   // The creatures of the terrain blocks that were cached at some point but aren't any
+   // more.  Stepped every `CoarsePopulations::interval` steps.
+   const CoarsePopulations& getCoarsePopulations() const { return coarse; }
+
+   // Generates the terrain; e.g. for showing parts of the map that aren't cached.
+   const MapGenerator& getMapGenerator() const { return mapGen; }
+
    // Coordinates are relative to the top-left cached terrain block.  No bounds-checking
    // is performed.  To access coordinates outside of the cached terrain,
    // updateTerrainCache has to be called first.
@@ -57,6 +200,10 @@ class World {
 
    bool isVegetated(Pos) const;
 
+   // The connected region of land or water a cached position belongs to.  An animal can
+   // move between two positions if and only if they're in the same region.
+   inline unsigned getRegion(const Pos&) const;
+
    // Can a creature of the given type survive at the given position?  I.e., does the tile
    // type match the creatures natural environment (auqatic or terrestrial)?
    bool isGoodPosition(const CreatureType&, Pos) const;
@@ -64,16 +211,36 @@ class World {
 
    int countCreatures(const Pos&, int radius, std::uint8_t creatureTypeIndex) const;
 
+   // Both write their results to `matches`, which is cleared first.
    template <int maxDist, typename UnaryPredicate>
-   std::vector<CreatureIt> getReachableCreatures(const Pos& start, UnaryPredicate,
-                                                 int& distanceToFood);
+   void getReachableCreatures(const Pos& start, UnaryPredicate, int& distanceToFood,
+                              std::vector<CreatureIt>& matches);
 
    template <int maxDist>
-   std::vector<CreatureIt> findFood(const CreatureInfo& animalInfo, int& distanceToFood);
+   void findFood(const CreatureInfo& animalInfo, int& distanceToFood,
+                 std::vector<CreatureIt>& food);
 
-   void spawnCreature(std::uint8_t creatureType, std::int64_t x, std::int64_t y);
+   // Get the field leading herbivores to plants or carnivores to herbivores on land or in
+   // water.  Computed on first use in each step.
+   const FlowField& getFoodField(bool forHerbivores, bool onLand);
+
+   FoodSearch getFoodSearch() const { return foodSearch; }
+   void setFoodSearch(FoodSearch search) { foodSearch = search; }
+
+   NeighborLookup getNeighborLookup() const { return neighborLookup; }
+   void setNeighborLookup(NeighborLookup lookup) { neighborLookup = lookup; }
+
+   CreatureStorage getCreatureStorage() const { return creatureStorage; }
+   void setCreatureStorage(CreatureStorage storage) { creatureStorage = storage; }
+
+   // Returns false without spawning the creature if the world is over its memory cap.
+   bool spawnCreature(std::uint8_t creatureType, std::int64_t x, std::int64_t y);
    // void spawnCreature(CreatureInfo&);
 
+   // Insert many creatures at once; only rehashes the hash map once.  All positions have
+   // to be cached and good positions for the respective creature.
+   void spawnCreatures(const std::vector<CreatureInfo>&);
+
    bool spawnOffspring(CreatureInfo& parentInfo);
 
    void leech(CreatureIt actorIt, CreatureIt targetIt);
@@ -88,8 +255,31 @@ class World {
 
    void hunt(CreatureIt animalIt);
 
-   // Get the shortest path from `start` to `dest` using the A* algorithm.
+   // Get a path from `start` to `dest`.  The first element is `dest` (or the position
+   // closest to it that can be reached, which is found without a search if `dest` is in
+   // another region), the last one is `start`.  Positions further
+   // apart than `PathHierarchy::clusterSize` are connected by `getHierarchicalPath`, the
+   // others by `getTilePath`.  Paths that reach `dest` are cached until the terrain cache
+   // changes; a later query from any position on such a path gets the rest of it.
    std::vector<Pos> getPath(Pos start, Pos dest) const;
+   // Like above, but reuses the memory of `path`.
+   void getPath(Pos start, Pos dest, std::vector<Pos>& path) const;
+
+   // The maximum number of paths `getPath` remembers.
+   std::size_t getPathCacheCapacity() const { return pathCache.getCapacity(); }
+   void setPathCacheCapacity(std::size_t capacity) { pathCache.setCapacity(capacity); }
+
+   // The position in `region` that is closest to `pos`.
+   Pos getClosestInRegion(const Pos& pos, unsigned region) const;
+
+   // Get the shortest path from `start` to `dest` using the A* algorithm on single tiles.
+   // Explores the start's whole region when `dest` can't be reached.
+   void getTilePath(Pos start, Pos dest, std::vector<Pos>& path) const;
+
+   // Get a near-optimal path using the cluster graph of the cached terrain (HPA*).  Cheap
+   // over long distances once the graph is built, which happens at most once after the
+   // terrain cache changed.
+   void getHierarchicalPath(Pos start, Pos dest, std::vector<Pos>& path) const;
 
    // Get all positions that are reachable without moving a distance greater than
    // `maxDist`.  I.e., positions that are within a distance of `maxDist` but require
@@ -97,12 +287,69 @@ class World {
    // excluded.  Uses breadth-first search.
    std::vector<Pos> getReachablePositions(const Pos& start, int maxDist) const;
 
+   // Call `visit(pos)` for every position other than `start` that `getReachablePositions`
+   // would return, in the order of their distance to `start`.
+   template <typename Visitor>
+   void forEachReachablePosition(const Pos& start, int maxDist, Visitor visit) const;
+
+   // Pick one of the positions `getReachablePositions` would return at random, without
+   // collecting them.  Excludes `start` unless `includeStart` is set; returns `start` if
+   // there's no other position.
+   Pos sampleReachablePosition(const Pos& start, int maxDist, bool includeStart) const;
+
    Pos moveTowards(CreatureIt animalIt, const Pos& dest, bool run);
 
+   // Run along a flow field towards its closest source.
+   Pos moveAlong(CreatureIt animalIt, const FlowField&);
+
   private:
    // Erase an animal from the hash map and, if necessary, from `moveeCache`.  Plants can
-   // just be removed with `std::unordered_multimap::erase()`.
+   // just be removed with `std::unordered_multimap::erase()` after `forgetCreature`.
    CreatureIt removeAnimal(CreatureIt);
+   // Remove a creature that's about to be erased during a step from the Z-order index.
+   void forgetCreature(const CreatureInfo&);
+
+   // Free unused memory if over the memory cap and update `overMemoryCap`.
+   void enforceMemoryCap();
+
+   std::size_t memoryCap = 0;
+   bool overMemoryCap = false;
+
+   // The searches of `getReachableCreatures`, `forEachReachablePosition` and
+   // `getTilePath`.  Reuses its memory.
+   mutable GridSearch gridSearch;
+
+   // The cached terrain as the window of a search.
+   GridSearch::Window getCacheWindow() const;
+
+   // The path `moveTowards` follows and the cells of `getHierarchicalPath`.
+   std::vector<Pos> movePath;
+   mutable std::vector<PathHierarchy::Cell> hierarchyCells;
+
+   // Drives all random decisions of the simulation.  Per world, so different worlds can
+   // be stepped on different threads.  Mutable, because `generateRoamState` is `const`.
+   SeedType seed;
+   mutable std::default_random_engine rNG{seed};
+
+   // Abstract graphs of the cached terrain for long searches.  Updated along with the
+   // cache.
+   mutable PathHierarchy pathHierarchy;
+
+   // Recently planned paths.  Cleared when the terrain cache changes.  A few thousand
+   // suffice for the animals that move along paths at the same time.
+   static constexpr std::size_t pathCacheCapacity = 4096;
+   static constexpr std::size_t pathCacheBytes = 8 << 20;
+   mutable PathCache<Pos, PosHash> pathCache{pathCacheCapacity, pathCacheBytes, nodePool};
+
+   // Updated along with the terrain cache, one block at a time.
+   RegionLabels regions{terrainBlockSize};
+   // Label the regions of `terrainBlocks[index]` after it was generated.
+   void labelBlock(std::size_t index);
+
+   CoarsePopulations coarse;
+   // Create the creatures of `terrainBlocks[index]`, which just entered the cache, from
+   // its coarse populations.
+   void refineBlock(std::size_t index);
 
    MapGenerator mapGen;
    static constexpr std::int64_t terrainBlockSize = MapGenerator::blockSize;
@@ -121,16 +368,69 @@ class World {
    // ...
    std::vector<CreatureIt> foodCache;
 
+   FoodSearch foodSearch = FoodSearch::perAnimal;
+   // Indexed by `2 * forHerbivores + onLand`.  A field is current if its step is
+   // `currentStep`.
+   std::array<FlowField, 4> foodFields;
+   std::array<int, 4> foodFieldSteps{{-1, -1, -1, -1}};
+   // The positions of plants and herbivores by medium, relative to the cached terrain.
+   // Collected along with the first field of a step.
+   std::array<std::vector<int>, 4> foodSources;
+   int foodSourcesStep = -1;
+
+   // The radius of the food searches with `FoodSearch::perAnimal`.
+   static constexpr int maxFoodDist = 10;
+   // Hungry animals without food nearby search for it again and again, mostly from the
+   // same few tiles.  A search of `findFood<maxFoodDist>` that found nothing is
+   // remembered by the tile it started from, stamped with `foodClock`.  It's still valid
+   // while no food arrived in any of the blocks of `foodBlockSize` tiles the search could
+   // have reached; arriving plants and herbivores stamp their block with a new time.
+   // Both are indexed by `forHerbivores`, relative to the cached terrain, and allocated
+   // by the first search that found nothing.
+   static constexpr int foodBlockSize = 8;
+   std::array<std::vector<std::uint32_t>, 2> noFoodStamps;  // By tile.
+   std::array<std::vector<std::uint32_t>, 2> foodBlockStamps;
+   std::uint32_t foodClock = 1;
+   // Whether `findFood<maxFoodDist>` would find nothing for the animal according to the
+   // stamps, and record that it did.
+   bool isFoodMissing(const CreatureInfo& animalInfo) const;
+   void rememberMissingFood(const CreatureInfo& animalInfo);
+   // Invalidate what was remembered around `pos` if the creature arriving there is food.
+   void noteFoodArrival(const Pos& pos, const Creature&);
+   // Forget everything, e.g. because the terrain cache moved.
+   void forgetMissingFood();
+
+   NeighborLookup neighborLookup = NeighborLookup::zOrder;
+   CreatureStorage creatureStorage = CreatureStorage::hashMap;
+   // The creatures of the cached terrain, relative to its top-left tile.  Current while
+   // `zOrderStep` is `currentStep`, i.e. from the start of a step until its moves and
+   // offspring are committed; creatures that die in between are removed.  With
+   // `CreatureStorage::zOrder`, committing a step makes it current for the next one,
+   // and anything that adds or removes creatures between steps invalidates it.
+   ZOrderIndex zOrderIndex;
+   int zOrderStep = -1;
+   void rebuildZOrderIndex();
+   // `commitStep` with `CreatureStorage::zOrder`.
+   void commitStepInZOrder();
+
+   // Holds the buffers below, which only live through a step.  `rewindStepArena`
+   // recreates them empty and rewinds it at the start of each step.
+   Arena stepArena;
+   template <typename T>
+   using StepVector = std::vector<T, ArenaAllocator<T>>;
+   void rewindStepArena();
+
    // Used to cache all the offspring spawned in one step before it is inserted into the
    // hash map.  Directly inserting new creatures into the hash map can invalidate
    // iterators.  It also would probably depend on the insertee's position whether the
    // current step's loop over the hash map will have its body executed for the new
    // creature or not.
-   std::vector<CreatureInfo> offspringCache;
+   StepVector<CreatureInfo> offspringCache{ArenaAllocator<CreatureInfo>{stepArena}};
 
    // Movee: one who is being moved, obviously.  This requires linear searches.  TODO:
    // come of with something better.
-   std::vector<std::pair<Pos, CreatureIt>> moveeCache;
+   StepVector<std::pair<Pos, CreatureIt>> moveeCache{
+       ArenaAllocator<std::pair<Pos, CreatureIt>>{stepArena}};
 
    // std::unordered_multimap<Pos, CreatureIt, PosHash> moveeCache;
 
@@ -157,6 +457,11 @@ bool World::isLand(std::int64_t x, std::int64_t y) const {
 
 bool World::isLand(World::Pos pos) const { return isLand(pos[0], pos[1]); }
 
+unsigned World::getRegion(const World::Pos& pos) const {
+   return regions.getRegion(static_cast<int>(pos[0] - left),
+                            static_cast<int>(pos[1] - top));
+}
+
 #endif  // WORLD_HPP_L42R9DKX
 
 // vim: tw=90 sts=-1 sw=3 et
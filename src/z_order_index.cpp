@@ -0,0 +1,126 @@
+#include "z_order_index.hpp"
+
+#include <algorithm>  // max, min
+#include <array>      // array
+#include <cassert>    // assert
+#include <cstdlib>    // abs
+
+#include "trace.hpp"
+
+constexpr int ZOrderIndex::cellSize;
+
+namespace {
+template <typename T>
+void release(std::vector<T>& v) {
+   v.clear();
+   v.shrink_to_fit();
+}
+}
+
+std::uint16_t ZOrderIndex::getCode(unsigned x, unsigned y) {
+   // Spread the 8 bits of a coordinate out to the even bits of 16.
+   auto spread = [](unsigned v) {
+      v = (v | v << 4) & 0x0f0f;
+      v = (v | v << 2) & 0x3333;
+      v = (v | v << 1) & 0x5555;
+      return v;
+   };
+   return static_cast<std::uint16_t>(spread(x) | spread(y) << 1);
+}
+
+void ZOrderIndex::clear(int size) {
+   assert(cellSize <= size && size <= 256 && (size & (size - 1)) == 0);
+   this->size = size;
+   entries.clear();
+   cellStarts.clear();
+}
+
+void ZOrderIndex::sort() {
+   TRACE_ZONE("ZOrderIndex::sort");
+   // Two passes over the bytes of the codes, the low one first.  Both histograms are
+   // counted in one go.
+   std::array<std::array<unsigned, 256>, 2> counts{};
+   for (const Entry& entry : entries) {
+      const unsigned code = getCode(entry.x, entry.y);
+      ++counts[0][code & 0xff];
+      ++counts[1][code >> 8];
+   }
+   // Entries can't be assigned (the type of a creature is const), so each pass finds the
+   // new place of every entry first and then copies the entries over in that order.
+   order.resize(entries.size());
+   for (int pass = 0; pass < 2; ++pass) {
+      std::array<unsigned, 256>& offsets = counts[pass];
+      unsigned offset = 0;
+      for (unsigned& count : offsets) {
+         const unsigned bucketSize = count;
+         count = offset;
+         offset += bucketSize;
+      }
+      const int shift = 8 * pass;
+      for (unsigned i = 0; i < entries.size(); ++i) {
+         const Entry& entry = entries[i];
+         order[offsets[getCode(entry.x, entry.y) >> shift & 0xff]++] = i;
+      }
+      scratch.clear();
+      for (unsigned i : order) scratch.push_back(entries[i]);
+      entries.swap(scratch);
+   }
+
+   // Cells are aligned, so the entries of each are contiguous.
+   const unsigned numCells = (size / cellSize) * (size / cellSize);
+   cellStarts.assign(numCells + 1, 0);
+   for (const Entry& entry : entries) ++cellStarts[getCell(entry.x, entry.y) + 1];
+   for (unsigned cell = 0; cell < numCells; ++cell) {
+      cellStarts[cell + 1] += cellStarts[cell];
+   }
+}
+
+void ZOrderIndex::remove(int x, int y, std::uint8_t typeIndex) {
+   const unsigned cell = getCell(x, y);
+   for (unsigned i = cellStarts[cell]; i != cellStarts[cell + 1]; ++i) {
+      Entry& entry = entries[i];
+      if (entry.isPresent && entry.x == x && entry.y == y &&
+          entry.creature.getTypeIndex() == typeIndex) {
+         entry.isPresent = false;
+         return;
+      }
+   }
+   assert(false && "removed a creature that isn't in the index");
+}
+
+int ZOrderIndex::count(int x, int y, int radius, std::uint8_t typeIndex,
+                       int& numCells) const {
+   assert(!cellStarts.empty());
+   const int minCellX = std::max(0, x - radius) / cellSize;
+   const int maxCellX = std::min(size - 1, x + radius) / cellSize;
+   const int minCellY = std::max(0, y - radius) / cellSize;
+   const int maxCellY = std::min(size - 1, y + radius) / cellSize;
+   int count = 0;
+   numCells = 0;
+   for (int cellY = minCellY; cellY <= maxCellY; ++cellY) {
+      for (int cellX = minCellX; cellX <= maxCellX; ++cellX) {
+         const unsigned cell = getCode(cellX, cellY);
+         ++numCells;
+         for (unsigned i = cellStarts[cell]; i != cellStarts[cell + 1]; ++i) {
+            const Entry& entry = entries[i];
+            count += entry.isPresent && entry.creature.getTypeIndex() == typeIndex &&
+                     std::abs(entry.x - x) + std::abs(entry.y - y) <= radius;
+         }
+      }
+   }
+   return count;
+}
+
+std::size_t ZOrderIndex::bytesUsed() const {
+   return (entries.capacity() + scratch.capacity()) * sizeof(Entry) +
+          (cellStarts.capacity() + order.capacity()) * sizeof(unsigned);
+}
+
+void ZOrderIndex::release() {
+   ::release(entries);
+   ::release(order);
+   ::release(scratch);
+   ::release(cellStarts);
+}
+
+// vim: tw=90 sts=-1 sw=3 et
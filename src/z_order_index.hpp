@@ -0,0 +1,83 @@
+#ifndef Z_ORDER_INDEX_HPP_P3MX8LWD
+#define Z_ORDER_INDEX_HPP_P3MX8LWD
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint8_t, uint16_t
+#include <vector>   // vector
+
+#include "creature.hpp"
+
+// Copies of the creatures of a square area in one array, sorted by the Morton code
+// (Z-order) of their positions, so creatures that are close on the map are mostly close
+// in memory.
+// Each aligned square of `cellSize` tiles is a contiguous range of the array, and the
+// start of every range is stored, so counting the creatures around a position scans a
+// few short runs of entries instead of looking up every position in a hash map.
+//
+// Entries are added unsorted and then sorted all at once by an LSD radix sort, which
+// takes linear time.  Removed creatures are only marked, so removing doesn't move any
+// entries.
+class ZOrderIndex {
+  public:
+   // The width of the cells, in tiles.
+   static constexpr int cellSize = 4;
+
+   // Forget all entries and prepare for an area of `size` x `size` tiles.  Cells are
+   // found by their Morton code, so `size` has to be a power of two between `cellSize`
+   // and 256.
+   void clear(int size);
+   // Add a copy of `creature` at (x, y), relative to the top-left tile of the area.
+   void add(int x, int y, const Creature& creature) {
+      entries.push_back(Entry{static_cast<std::uint8_t>(x), static_cast<std::uint8_t>(y),
+                              true, creature});
+   }
+   // Sort the entries added since `clear`.  Has to be called before the other methods.
+   void sort();
+
+   // Mark one creature of the type at (x, y) as removed; there has to be one.
+   void remove(int x, int y, std::uint8_t typeIndex);
+
+   // The number of creatures of the type within `radius` of (x, y) (in Manhattan
+   // metric), and the number of cells that were scanned.
+   int count(int x, int y, int radius, std::uint8_t typeIndex, int& numCells) const;
+
+   // Call `visit(x, y, creature)` for every creature that wasn't removed, in Z-order.
+   template <typename Visitor>
+   void forEachCreature(Visitor visit) const {
+      for (const Entry& entry : entries) {
+         if (entry.isPresent) visit(entry.x, entry.y, entry.creature);
+      }
+   }
+
+   // The memory held by the entries, the cells and the sort.
+   std::size_t bytesUsed() const;
+   // Free all memory.
+   void release();
+
+  private:
+   struct Entry {
+      std::uint8_t x, y;
+      bool isPresent;
+      Creature creature;
+   };
+
+   // Interleave the bits of `x` and `y`, starting with the lowest bit of `x`.
+   static std::uint16_t getCode(unsigned x, unsigned y);
+
+   // The index of the cell containing (x, y) in `cellStarts`; Z-order as well.
+   static unsigned getCell(unsigned x, unsigned y) {
+      return getCode(x / cellSize, y / cellSize);
+   }
+
+   int size = 0;
+   std::vector<Entry> entries;
+   // Of the radix sort.
+   std::vector<unsigned> order;
+   std::vector<Entry> scratch;
+   // The first entry of each cell, and the number of entries at the end.
+   std::vector<unsigned> cellStarts;
+};
+
+#endif  // Z_ORDER_INDEX_HPP_P3MX8LWD
+
+// vim: tw=90 sts=-1 sw=3 et
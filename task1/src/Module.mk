@@ -1,6 +1,6 @@
 local_sources := $(shell find $(subdirectory) -maxdepth 1 -name '*.cpp')
 local_objects := $(addprefix $(OBJDIR)/,$(subst src/,,$(local_sources:.cpp=.o)) \
-   creature_type.o creature_parser.o)
+   creature_type.o creature_parser.o mapped_file.o)
 local_program := $(OBJDIR)/$(subst src,,$(subdirectory))task1
 
 sources  += $(local_sources)
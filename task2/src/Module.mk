@@ -1,5 +1,6 @@
 local_sources := $(shell find $(subdirectory) -maxdepth 1 -name '*.cpp')
-local_objects := $(addprefix $(OBJDIR)/,$(subst src/,,$(local_sources:.cpp=.o)))
+local_objects := $(addprefix $(OBJDIR)/,$(subst src/,,$(local_sources:.cpp=.o)) \
+   targa.o)
 local_program := $(OBJDIR)/$(subst src,,$(subdirectory))task2
 
 sources  += $(local_sources)
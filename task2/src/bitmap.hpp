@@ -4,19 +4,23 @@
 #include <array>
 #include <climits> // CHAR_BIT
 #include <cstdint> // uint8_t
-#include <memory>  // unique_ptr
+#include <iosfwd>  // ostream
+#include <string>  // string
+#include <vector>  // vector
 
-#include <boost/detail/endian.hpp>  // BOOST_LITTLE_ENDIAN
+#include <boost/predef/other/endian.h>  // BOOST_ENDIAN_LITTLE_BYTE
 
 // Assert some basic things about the target machine at compile-time.  Prudence, not
 // doubt.
 static_assert (CHAR_BIT == 8, "The Bitmap class relies on bytes having 8 bits");
-#ifndef BOOST_LITTLE_ENDIAN
+#if !BOOST_ENDIAN_LITTLE_BYTE
    #error The Bitmap class relies on little-endian byte order being used
 #endif
 
 using RGBAQuadlet = std::array<std::uint8_t, 4>;
 
+// An image loaded from a TGA file by `loadTarga`.  The quadlets keep the byte order of
+// the file, i.e. blue, green, red, alpha; row 0 is the bottom row.
 struct Bitmap {
    Bitmap(const std::string& path);
    const RGBAQuadlet* operator[](int row) const;
@@ -24,7 +28,7 @@ struct Bitmap {
    friend std::ostream& operator<<(std::ostream&, const Bitmap&);
   private:
    std::size_t numRows, numCols;
-   std::unique_ptr<RGBAQuadlet[]> quadlets;
+   std::vector<RGBAQuadlet> quadlets;
 };
 
 #endif // BITMAP_HPP_VEAHQYJM